@@ -1,242 +1,391 @@
 #include "audioprocessor.h"
+#include "threadpool.h"
+#include "simdkernels.h"
 
 #include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
 
-#include <iostream>
 using namespace std;
 
-void MatrixMath::fft(std::valarray<std::complex<long double>> & complexFrame) {
-    // DFT
-    const size_t N = complexFrame.size();
-    if (N <= 1) return;
+template<typename T>
+MatrixMath<T>::FFTPlan::FFTPlan(unsigned int size) : N(size), bitReversed(size, 0), twiddles(size/2) {
+    unsigned int numBits = 0;
+    while((1u << numBits) < N)
+        numBits++;
+
+    for(unsigned int i = 0; i < N; i++){
+        unsigned int reversed = 0;
+        for(unsigned int b = 0; b < numBits; b++){
+            if(i & (1u << b))
+                reversed |= 1u << (numBits - 1 - b);
+        }
+        bitReversed[i] = reversed;
+    }
 
-    // divide
-    std::valarray<std::complex<long double>> even = complexFrame[std::slice(0, N/2, 2)];
-    std::valarray<std::complex<long double>>  odd = complexFrame[std::slice(1, N/2, 2)];
+    for(unsigned int k = 0; k < N/2; k++){
+        twiddles[k] = std::complex<T>(std::polar(1.0L, -2 * 3.14159265358979323846264338328L * k / N));
+    }
+}
 
-    // conquer
-    fft(even);
-    fft(odd);
+template<typename T>
+void MatrixMath<T>::FFTPlan::transform(std::complex<T> * data) const {
+    // reorder input so butterflies can be computed in place
+    for(unsigned int i = 0; i < N; i++){
+        const unsigned int j = bitReversed[i];
+        if(i < j)
+            std::swap(data[i], data[j]);
+    }
+
+    unsigned int half = 1; // half of size of currently combined DFTs
+    if(N >= 4){
+        // first two stages as single radix-4 pass, twiddles here are 1 and -i so no multiplications are required
+        for(unsigned int i = 0; i < N; i += 4){
+            const std::complex<T> t0 = data[i] + data[i + 1];
+            const std::complex<T> t1 = data[i] - data[i + 1];
+            const std::complex<T> t2 = data[i + 2] + data[i + 3];
+            const std::complex<T> t3 = data[i + 2] - data[i + 3];
+            const std::complex<T> t3j(t3.imag(), -t3.real()); // t3 * -i
+
+            data[i    ] = t0 + t2;
+            data[i + 2] = t0 - t2;
+            data[i + 1] = t1 + t3j;
+            data[i + 3] = t1 - t3j;
+        }
+        half = 4;
+    }
+
+    // remaining radix-2 stages
+    for(; half < N; half *= 2){
+        const unsigned int twiddleStep = N / (2 * half);
+        for(unsigned int i = 0; i < N; i += 2 * half){
+            for(unsigned int k = 0; k < half; k++){
+                const std::complex<T> t = twiddles[k * twiddleStep] * data[i + k + half];
+                data[i + k + half] = data[i + k] - t;
+                data[i + k] += t;
+            }
+        }
+    }
+}
 
-    // combine
-    for (size_t k = 0; k < N/2; ++k)
-    {
-        std::complex<long double> t = std::polar(1.0L, -2 * 3.14159265358979323846264338328L * k / N) * odd[k];
-        complexFrame[k    ] = even[k] + t;
-        complexFrame[k+N/2] = even[k] - t;
+template<typename T>
+MatrixMath<T>::RealFFTPlan::RealFFTPlan(unsigned int size) : N(size), halfPlan(size/2), twiddles(size/2) {
+    for(unsigned int k = 0; k < N/2; k++){
+        twiddles[k] = std::complex<T>(std::polar(1.0L, -2 * 3.14159265358979323846264338328L * k / N));
     }
 }
 
-void MatrixMath::transposeMatrix(vec2d & v){
-    vec2d res(v[0].size(), vec(v.size(),0));
+template<typename T>
+void MatrixMath<T>::RealFFTPlan::powerSpectrum(const T * samples, unsigned int numSamples, T * power,
+                                            std::complex<T> * buffer, T scale) const {
+    // either append zeros or turncate samples
+    numSamples = std::min(numSamples, N);
+
+    if(N == 1){
+        power[0] = numSamples ? samples[0] * samples[0] * scale : 0;
+        return;
+    }
+
+    // pack even samples into real part and odd samples into imaginary part
+    const unsigned int M = N/2;
+    for(unsigned int n = 0; n < M; n++){
+        const T even = 2*n < numSamples ? samples[2*n] : 0;
+        const T odd = 2*n + 1 < numSamples ? samples[2*n + 1] : 0;
+        buffer[n] = std::complex<T>(even, odd);
+    }
+
+    halfPlan.transform(buffer);
+
+    // split spectrum of packed signal into spectrum of even and odd samples and combine them
+    power[0] = (buffer[0].real() + buffer[0].imag()) * (buffer[0].real() + buffer[0].imag()) * scale;
+    power[M] = (buffer[0].real() - buffer[0].imag()) * (buffer[0].real() - buffer[0].imag()) * scale;
+    // bins k and M - k depend on the same pair of values so spectrum can be combined in place
+    for(unsigned int k = 1; 2*k <= M; k++){
+        const unsigned int m = M - k;
+        const std::complex<T> zk = buffer[k];
+        const std::complex<T> zm = buffer[m];
+        const std::complex<T> evenK = static_cast<T>(0.5) * (zk + std::conj(zm));
+        const std::complex<T> oddK = std::complex<T>(0, static_cast<T>(-0.5)) * (zk - std::conj(zm));
+        const std::complex<T> evenM = static_cast<T>(0.5) * (zm + std::conj(zk));
+        const std::complex<T> oddM = std::complex<T>(0, static_cast<T>(-0.5)) * (zm - std::conj(zk));
+        buffer[k] = evenK + twiddles[k] * oddK;
+        buffer[m] = evenM + twiddles[m] * oddM;
+    }
+    SimdKernels::squaredMagnitude(buffer + 1, power + 1, M - 1, scale);
+}
 
-    for(unsigned int i = 0; i < res.size(); i++){
-        for(unsigned int j = 0; j < res[i].size(); j++){
-            res[i][j] = v[j][i];
+template<typename T>
+MatrixMath<T>::DCTPlan::DCTPlan(unsigned int size, unsigned int first, unsigned int numCoeffs, const vec & weights)
+    : N(size), firstCoeff(first), basis(numCoeffs, size) {
+    for(unsigned int k = 0; k < numCoeffs; k++){
+        const unsigned int i = firstCoeff + k;
+        const long double norm = i == 0 ? 1 / std::sqrt(static_cast<long double>(N)) : std::sqrt(2 / static_cast<long double>(N));
+        const long double weight = weights.empty() ? 1 : weights[k];
+        for(unsigned int j = 0; j < N; j++){
+            basis(k, j) = static_cast<T>(weight * norm * std::cos(3.14159265358979323846264338328L*i*(2*j+1)/(2*N)));
         }
     }
+}
+
+template<typename T>
+void MatrixMath<T>::DCTPlan::transform(const T * in, T * out) const {
+    for(std::size_t k = 0; k < basis.rows(); k++){
+        const T * cosines = basis.row(k);
+        T sum = 0;
+        for(unsigned int j = 0; j < N; j++){
+            sum += in[j] * cosines[j];
+        }
+        out[k] = sum;
+    }
+}
 
+template<typename T>
+void MatrixMath<T>::transposeMatrix(vec2d & v){
+    vec2d res(v.cols(), v.rows());
+    transposeMatrix(v, res);
     v = std::move(res);
 }
 
-void MatrixMath::dotMatrix(vec2d & first, const vec2d & second) {
-    vec2d res(first.size(), vec(second[0].size(), 0));
+template<typename T>
+void MatrixMath<T>::transposeMatrix(const vec2d & v, vec2d & result){
+    // copy in small tiles so both matrices are accessed in cache friendly way
+    const std::size_t tile = 16;
+    for(std::size_t i0 = 0; i0 < v.rows(); i0 += tile){
+        const std::size_t iEnd = std::min(i0 + tile, v.rows());
+        for(std::size_t j0 = 0; j0 < v.cols(); j0 += tile){
+            const std::size_t jEnd = std::min(j0 + tile, v.cols());
+            for(std::size_t i = i0; i < iEnd; i++){
+                for(std::size_t j = j0; j < jEnd; j++){
+                    result(j, i) = v(i, j);
+                }
+            }
+        }
+    }
+}
+
+template<typename T>
+void MatrixMath<T>::dotMatrix(vec2d & first, const vec2d & second) {
+    vec2d res(first.rows(), second.cols());
 
     // for each row in first array
-    for(unsigned int i = 0; i < first.size(); i++){
-        // for each column in second array
-        for(unsigned int j = 0; j < second[0].size(); j++){
-            long double sum = 0;
-            // sum each element
-            for(unsigned int k = 0; k < first[i].size(); k++){
-                 sum += first[i][k] * second[k][j];
+    for(std::size_t i = 0; i < first.rows(); i++){
+        T * resRow = res.row(i);
+        // accumulate rows of second array weighted by elements of first array
+        for(std::size_t k = 0; k < first.cols(); k++){
+            const T a = first(i, k);
+            const T * secondRow = second.row(k);
+            for(std::size_t j = 0; j < second.cols(); j++){
+                resRow[j] += a * secondRow[j];
             }
-            res[i][j] = sum;
         }
     }
-    first.clear();
     first = std::move(res);
 }
 
-void MatrixMath::subtractMatrixByRows(vec2d & first, const vec & second){
-    for(unsigned int i = 0; i < first.size(); i++){
-        for(unsigned int j = 0; j < first[i].size(); j++){
-            first[i][j] -= second[j];
-        }
+template<typename T>
+void MatrixMath<T>::subtractMatrixByRows(vec2d & first, const vec & second){
+    for(std::size_t i = 0; i < first.rows(); i++){
+        SimdKernels::subtract(first.row(i), second.data(), first.cols());
     }
 }
 
-void MatrixMath::eraseColumnsMatrix(vec2d & v, unsigned int numFromStart, unsigned int numToEnd){
-    for(unsigned int i = 0; i < v.size(); i++){
-        v[i].erase(v[i].begin(), v[i].begin() + numFromStart);
-        v[i].erase(v[i].end() - numToEnd, v[i].end());
-    }
+template<typename T>
+void MatrixMath<T>::eraseColumnsMatrix(vec2d & v, unsigned int numFromStart, unsigned int numToEnd){
+    const vec2d kept = v.view(0, v.rows(), numFromStart, v.cols() - numFromStart - numToEnd);
+    v = kept; // copy of a view owns it's elements
 }
 
-void MatrixMath::stabilizeMatrix(vec2d & v){
-    for(unsigned int i = 0; i < v.size(); i++){
-        for(unsigned int j = 0; j < v[i].size(); j++){
-            if(v[i][j] == 0)
-                v[i][j] = std::numeric_limits<long double>::epsilon();
-        }
+template<typename T>
+void MatrixMath<T>::stabilizeMatrix(vec2d & v){
+    for(std::size_t i = 0; i < v.rows(); i++){
+        SimdKernels::replaceZeros(v.row(i), v.cols(), std::numeric_limits<T>::epsilon());
     }
 }
 
-void MatrixMath::rescaleMatrix(vec2d & v, long double minVal, long double maxVal){
-    const long double minValSrc = minMatrix(v);
-    const long double maxValSrc = maxMatrix(v);
-    const long double a = (maxVal - minVal)/(maxValSrc - minValSrc);
-    const long double b = minVal - a * minValSrc;
+template<typename T>
+void MatrixMath<T>::rescaleMatrix(vec2d & v, T minVal, T maxVal){
+    const T minValSrc = minMatrix(v);
+    const T maxValSrc = maxMatrix(v);
+    const T a = (maxVal - minVal)/(maxValSrc - minValSrc);
+    const T b = minVal - a * minValSrc;
 
-    for(unsigned int i = 0; i < v.size(); i++){
-        for(unsigned int j = 0; j < v[i].size(); j++){
-                v[i][j] = a*v[i][j] + b;
-        }
+    for(std::size_t i = 0; i < v.rows(); i++){
+        SimdKernels::affine(v.row(i), v.cols(), a, b);
     }
+}
 
+template<typename T>
+auto MatrixMath<T>::meansMatrixByColumns(const vec2d & v) -> vec {
+    vec result;
+    meansMatrixByColumns(v, result);
+    return result;
 }
 
-auto MatrixMath::meansMatrixByColumns(const vec2d & v) -> vec {
-    vec result(v[0].size(), 0);
+template<typename T>
+void MatrixMath<T>::meansMatrixByColumns(const vec2d & v, vec & means){
+    means.assign(v.cols(), 0);
 
-    for(unsigned int i = 0; i < v[0].size(); i++){
-        long double mean = 0;
-        for(unsigned int j = 0; j < v.size(); j++){
-            mean += v[j][i];
+    // walk matrix row by row and accumulate every column at once
+    for(std::size_t i = 0; i < v.rows(); i++){
+        const T * row = v.row(i);
+        for(std::size_t j = 0; j < v.cols(); j++){
+            means[j] += row[j];
         }
-        mean = mean / v.size();
-        result[i] = mean;
     }
-
-    return result;
+    for(std::size_t j = 0; j < v.cols(); j++){
+        means[j] = means[j] / v.rows();
+    }
 }
 
-auto MatrixMath::minMatrixByColumns(const vec2d & v) -> vec {
-    vec res(v[0].size(), 0);
+template<typename T>
+auto MatrixMath<T>::minMatrixByColumns(const vec2d & v) -> vec {
+    vec res(v.row(0), v.row(0) + v.cols());
 
-    for(unsigned int i = 0; i < v[0].size(); i++){
-        vec temp(v.size(), 0);
-        for(unsigned int j = 0; j < v.size(); j++){
-            temp[j] = v[j][i];
+    for(std::size_t i = 1; i < v.rows(); i++){
+        const T * row = v.row(i);
+        for(std::size_t j = 0; j < v.cols(); j++){
+            res[j] = std::min(res[j], row[j]);
         }
-        res[i] = *std::min_element(temp.begin(), temp.end());
     }
 
     return res;
 }
 
-auto MatrixMath::maxMatrixByColumns(const vec2d & v) -> vec {
-    vec res(v[0].size(), 0);
+template<typename T>
+auto MatrixMath<T>::maxMatrixByColumns(const vec2d & v) -> vec {
+    vec res(v.row(0), v.row(0) + v.cols());
 
-    for(unsigned int i = 0; i < v[0].size(); i++){
-        vec temp(v.size(), 0);
-        for(unsigned int j = 0; j < v.size(); j++){
-            temp[j] = v[j][i];
+    for(std::size_t i = 1; i < v.rows(); i++){
+        const T * row = v.row(i);
+        for(std::size_t j = 0; j < v.cols(); j++){
+            res[j] = std::max(res[j], row[j]);
         }
-        res[i] = *std::max_element(temp.begin(), temp.end());
     }
 
     return res;
 }
 
-void MatrixMath::normalizeMatrixByColumns(vec2d & v){
-    vec means = meansMatrixByColumns(v);
-    vec mins = minMatrixByColumns(v);
-    vec maxs = maxMatrixByColumns(v);
-    for(unsigned int i = 0; i < v.size(); i++){
-        for(unsigned int j = 0; j < v[i].size(); j++){
-            v[i][j] = (v[i][j] - means[j]);//(maxs[j] - mins[j]);
-        }
-    }
+template<typename T>
+void MatrixMath<T>::normalizeMatrixByColumns(vec2d & v){
+    // only mean is subtracted, dividing by range of column (max - min) is disabled
+    subtractMatrixByRows(v, meansMatrixByColumns(v));
 }
 
-long double MatrixMath::minMatrix(const MatrixMath::vec2d & v){
-    long double minVal = std::numeric_limits<long double>::max();
+template<typename T>
+T MatrixMath<T>::minMatrix(const vec2d & v){
+    T minVal = std::numeric_limits<T>::max();
 
-    for(unsigned int i = 0; i < v.size(); i++){
-        for(unsigned int j = 0; j < v[i].size(); j++){
-            if(v[i][j] < minVal)
-                minVal = v[i][j];
+    for(std::size_t i = 0; i < v.rows(); i++){
+        const T * row = v.row(i);
+        for(std::size_t j = 0; j < v.cols(); j++){
+            if(row[j] < minVal)
+                minVal = row[j];
         }
     }
 
     return minVal;
 }
 
-long double MatrixMath::maxMatrix(const MatrixMath::vec2d & v){
-    long double maxVal = std::numeric_limits<long double>::min();
+template<typename T>
+T MatrixMath<T>::maxMatrix(const vec2d & v){
+    T maxVal = std::numeric_limits<T>::lowest();
 
-    for(unsigned int i = 0; i < v.size(); i++){
-        for(unsigned int j = 0; j < v[i].size(); j++){
-            if(v[i][j] > maxVal)
-                maxVal = v[i][j];
+    for(std::size_t i = 0; i < v.rows(); i++){
+        const T * row = v.row(i);
+        for(std::size_t j = 0; j < v.cols(); j++){
+            if(row[j] > maxVal)
+                maxVal = row[j];
         }
     }
 
     return maxVal;
 }
 
-void MatrixMath::fftVector(vec & frame, unsigned int NFFT) {
-    // resize frame to N
-    // either append zeros or turncate samples
-    if(NFFT > frame.size()){
-        MatrixMath::vec zeros(NFFT - frame.size(), 0);
-        frame.insert(frame.end(), zeros.begin(), zeros.end());
-    }
-    else if(NFFT < frame.size()){
-        frame.erase(frame.begin() + NFFT, frame.end());
-    }
+template<typename T>
+void MatrixMath<T>::fftVector(vec & frame, const RealFFTPlan & plan, cvec & buffer) {
+    const unsigned int NFFT = plan.size();
+    const unsigned int numBins = NFFT/2+1; // only left half of spectrum
+
+    // power spectrum is normalized by number of bins in single row
+    const unsigned int numSamples = static_cast<unsigned int>(frame.size());
+    if(frame.size() < numBins)
+        frame.resize(numBins);
+    plan.powerSpectrum(frame.data(), numSamples, frame.data(), buffer.data(), 1 / static_cast<T>(numBins));
+    frame.resize(numBins);
+}
 
-    // "copy" vec into complex vector
-    std::valarray<std::complex<long double>> complexFrame(frame.size());
-    for(unsigned int i = 0; i < frame.size(); i++)
-        complexFrame[i] = frame[i];
+template<typename T>
+void MatrixMath<T>::fftMatrix(vec2d & frames, const RealFFTPlan & plan) {
+    vec2d power(frames.rows(), plan.size()/2+1); // only left half of spectrum
+    cvec buffer(plan.size()/2); // shared by every frame
+    fftMatrix(frames, plan, power, buffer.data());
+    frames = std::move(power);
+}
 
-    // fourier transform
-    MatrixMath::fft(complexFrame);
+template<typename T>
+void MatrixMath<T>::fftMatrix(const vec2d & frames, const RealFFTPlan & plan, vec2d & power, std::complex<T> * buffer) {
+    const unsigned int numBins = plan.size()/2+1; // only left half of spectrum
 
-    // compute magnitude of FFT
-    frame.clear();
-    frame.resize(NFFT/2+1); // only left half of spectrum
-    for(unsigned int i = 0; i < frame.size(); i++){
-        frame[i] = sqrt(complexFrame[i].real() * complexFrame[i].real() + complexFrame[i].imag() * complexFrame[i].imag());
+    // power spectrum is normalized by number of bins in single row
+    for(std::size_t i = 0; i < frames.rows(); i++){
+        plan.powerSpectrum(frames.row(i), static_cast<unsigned int>(frames.cols()), power.row(i), buffer, 1 / static_cast<T>(numBins));
     }
 }
 
-void MatrixMath::fftMatrix(MatrixMath::vec2d & frames, unsigned int NFFT) {
-    for(unsigned int i = 0; i < frames.size(); i++){
-        fftVector(frames[i], NFFT);
+template<typename T>
+void MatrixMath<T>::dct(const T * in, T * out, unsigned int N){
+    out[0] = 0;
+    for(unsigned int i = 0; i < N; i++)
+        out[0] += in[i];
+    out[0] *= 1 / sqrt(N);
+
+    for(unsigned int i = 1; i < N; i++){
+        out[i] = 0;
+        for(unsigned int j = 0; j < N; j++){
+            out[i] += in[j]*cos(static_cast<T>(3.14159265358979323846264338328L)*i*(2*j+1)/(2*N));
+        }
+        out[i] *= sqrt(2 / static_cast<T>(N));
     }
 }
 
-void MatrixMath::dctVector(vec & v){
+template<typename T>
+void MatrixMath<T>::dctVector(vec & v){
     vec result(v.size(), 0);
+    dct(v.data(), result.data(), static_cast<unsigned int>(v.size()));
+    v = std::move(result);
+}
 
-    for(unsigned int i = 0; i < v.size(); i++)
-        result[0] += v[i];
-    result[0] *= 1 / sqrt(v.size());
-
-    for(unsigned int i = 1; i < result.size(); i++){
-        for(unsigned int j = 0; j < v.size(); j++){
-            result[i] += v[j]*cos(3.14159265358979323846264338328L*i*(2*j+1)/(2*v.size()));
-        }
-        result[i] *= sqrt(2 / static_cast<long double>(v.size()));
+template<typename T>
+void MatrixMath<T>::dctMatrix(vec2d & m){
+    vec2d result(m.rows(), m.cols());
+    for(std::size_t i = 0; i < m.rows(); i++){
+        dct(m.row(i), result.row(i), static_cast<unsigned int>(m.cols()));
     }
+    m = std::move(result);
+}
 
-    v = std::move(result);
+template<typename T>
+void MatrixMath<T>::dctMatrix(vec2d & m, const DCTPlan & plan){
+    vec2d result(m.rows(), plan.numCoeffs());
+    dctMatrix(m, plan, result);
+    m = std::move(result);
 }
 
-void MatrixMath::dctMatrix(vec2d & m){
-    for(unsigned int i = 0; i < m.size(); i++){
-        dctVector(m[i]);
+template<typename T>
+void MatrixMath<T>::dctMatrix(const vec2d & m, const DCTPlan & plan, vec2d & result){
+    for(std::size_t i = 0; i < m.rows(); i++){
+        plan.transform(m.row(i), result.row(i));
     }
 }
 
-auto MatrixMath::linspace(long double low, long double high, unsigned int numPoints) -> MatrixMath::vec {
-    MatrixMath::vec result(numPoints, 0);
+template<typename T>
+auto MatrixMath<T>::linspace(T low, T high, unsigned int numPoints) -> vec {
+    vec result(numPoints, 0);
 
-    long double diff = high - low;
-    long double step = diff / numPoints;
+    T diff = high - low;
+    T step = diff / numPoints;
 
     for(unsigned int i = 0; i < numPoints; i++){
         result[i] = low + i*step;
@@ -248,219 +397,602 @@ auto MatrixMath::linspace(long double low, long double high, unsigned int numPoi
     return result;
 }
 
-bool AudioProcessor::validateConfig() const {
-    if(conf.bytesPerSample == 0 || conf.bytesPerSample > 2)
+template<typename T>
+auto MatrixMath<T>::window(WindowFunction type, unsigned int length) -> const vec & {
+    static std::map<std::pair<WindowFunction, unsigned int>, vec> cache;
+    static std::mutex cacheMutex;
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    auto it = cache.find({type, length});
+    if(it != cache.end())
+        return it->second;
+
+    const long double pi = 3.14159265358979323846264338328L;
+    vec coeffs(length, 1);
+    for(unsigned int n = 0; n < length && length > 1; n++){
+        const long double x = 2 * pi * n / (length - 1);
+        switch(type){
+        case WindowFunction::Hamming:
+            coeffs[n] = static_cast<T>(0.54L - 0.46L * std::cos(x));
+            break;
+        case WindowFunction::Hann:
+            coeffs[n] = static_cast<T>(0.5L - 0.5L * std::cos(x));
+            break;
+        case WindowFunction::Blackman:
+            coeffs[n] = static_cast<T>(0.42L - 0.5L * std::cos(x) + 0.08L * std::cos(2 * x));
+            break;
+        case WindowFunction::Rectangular:
+            break;
+        }
+    }
+
+    return cache.emplace(std::make_pair(type, length), std::move(coeffs)).first->second;
+}
+
+template<typename T>
+bool AudioProcessor<T>::validateConfig(const config & c) {
+    if(c.bytesPerSample == 0 || c.bytesPerSample > 2)
+        return 0;
+    if(c.numberOfChannels == 0)
         return 0;
-    if(conf.numberOfChannels == 0)
+    if(c.sampleRate == 0)
         return 0;
-    if(conf.sampleRate == 0)
+    if(c.framingSize == 0)
         return 0;
-    if(conf.framingSize == 0)
+    if(c.framingStride == 0)
         return 0;
-    if(conf.framingStride == 0)
+    if(c.NFFT == 0 || (c.NFFT & (c.NFFT - 1)))
         return 0;
-    if(conf.NFFT == 0)
+    if(c.numberOfFilterBanks == 0)
         return 0;
-    if(conf.numberOfFilterBanks == 0)
+    if(c.MFCC && c.firstMFCC < 1)
         return 0;
-    if(conf.MFCC && conf.firstMFCC > conf.numberOfFilterBanks)
+    if(c.MFCC && c.firstMFCC > c.numberOfFilterBanks)
         return 0;
-    if(conf.MFCC && conf.lastMFCC > conf.numberOfFilterBanks)
+    if(c.MFCC && c.lastMFCC > c.numberOfFilterBanks)
         return 0;
-    if(conf.MFCC && conf.firstMFCC > conf.lastMFCC)
+    if(c.MFCC && c.firstMFCC > c.lastMFCC)
         return 0;
-    if(conf.MFCC && conf.sinLift && conf.cepLifter < 1)
+    if(c.MFCC && c.sinLift && c.cepLifter < 1)
         return 0;
-    if(conf.rescale && conf.rescaleMax == conf.rescaleMin)
+    if(c.rescale && c.rescaleMax == c.rescaleMin)
         return 0;
     return 1;
 }
 
-auto AudioProcessor::bytesToSamples(const byteVec & buffer) const -> MatrixMath::vec {
+template<typename T>
+auto AudioProcessor<T>::buildPlan(const config & c) -> std::shared_ptr<const Plan> {
+    if(!validateConfig(c))
+        return nullptr;
 
-    if(buffer.size() % conf.bytesPerSample * conf.numberOfChannels){
-        throw AudioProcessorException("Invalid size of input audio buffer.");
-    }
+    auto plan = std::make_shared<Plan>();
+    plan->frameLength = static_cast<unsigned int>(round(c.framingSize / static_cast<T>(1000) * c.sampleRate));
+    plan->frameStep = static_cast<unsigned int>(round(c.framingStride / static_cast<T>(1000) * c.sampleRate));
+    if(plan->frameLength == 0 || plan->frameStep == 0)
+        return nullptr;
 
-    MatrixMath::vec samples(buffer.size()/conf.bytesPerSample, 0);
-    for(unsigned int i = 0, j = 0; i < buffer.size(); i += conf.bytesPerSample, j++){
-        uint32_t sample = 0;
-        for(unsigned int k = 0; k < conf.bytesPerSample; k++){
-            //sample |= static_cast<unsigned int>((static_cast<unsigned char>(buffer[i + k]) << (8 * k)));
-            sample |= (static_cast<uint8_t>(buffer[i + k]) << (8 * k));
-        }
-        if(conf.bytesPerSample == 1){
-            samples[j] = static_cast<uint8_t>(sample);
-        }
-        else if(conf.bytesPerSample == 2){
-            samples[j] = static_cast<int16_t>(sample);
+    plan->window = &Math::window(c.window, plan->frameLength);
+    plan->fft = typename Math::RealFFTPlan(c.NFFT);
+    plan->melFilters = buildFilterBanks(c);
+    if(c.MFCC)
+        plan->dct = buildDCT(c);
+
+    return plan;
+}
+
+template<typename T>
+auto AudioProcessor<T>::getPlan(const config & c) -> std::shared_ptr<const Plan> {
+    static std::mutex cacheMutex;
+    static std::vector<std::pair<config, std::shared_ptr<const Plan>>> cache; // least recently used first
+    const std::size_t maxCachedPlans = 8;
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    for(std::size_t i = 0; i < cache.size(); i++){
+        if(cache[i].first == c){
+            std::rotate(cache.begin() + i, cache.begin() + i + 1, cache.end());
+            return cache.back().second;
         }
     }
 
-    return samples;
+    std::shared_ptr<const Plan> plan = buildPlan(c);
+    if(cache.size() == maxCachedPlans)
+        cache.erase(cache.begin());
+    cache.emplace_back(c, plan);
+
+    return plan;
 }
 
-void AudioProcessor::channelsToMono(MatrixMath::vec & sampleData) const {
+template<typename T>
+void AudioProcessor<T>::setConfig(config c){
+    conf = c;
+    resetStream();
 
-    MatrixMath::vec samplesMono(sampleData.size()/conf.numberOfChannels,0);
+    // tables are computed once per config and reused for every processed buffer
+    plan = getPlan(conf);
+}
 
-    for(unsigned int i = 0, j = 0; i < sampleData.size(); i+=conf.numberOfChannels, j++){
-        long double sumSignals = 0;
-        for(unsigned int k = 0; k < conf.numberOfChannels; k++){
-            sumSignals += sampleData[i + k];
-        }
-        samplesMono[j] = sumSignals / static_cast<long double>(conf.numberOfChannels);
+template<typename T>
+template<typename Byte>
+T AudioProcessor<T>::decodeSample(const Byte * bytes) const {
+    uint32_t sample = 0;
+    for(unsigned int k = 0; k < conf.bytesPerSample; k++){
+        sample |= (static_cast<uint32_t>(static_cast<uint8_t>(bytes[k])) << (8 * k));
     }
-
-    sampleData = std::move(samplesMono);
+    if(conf.bytesPerSample == 1){
+        return static_cast<uint8_t>(sample);
+    }
+    return static_cast<int16_t>(sample);
 }
 
-void AudioProcessor::magnitudeToPower(MatrixMath::vec2d & magnitudes) {
-    for(unsigned int i = 0; i < magnitudes.size(); i++){
-        for(unsigned int j = 0; j < magnitudes[i].size(); j++){
-            unsigned int N = magnitudes[i].size();
-            magnitudes[i][j] = magnitudes[i][j] * magnitudes[i][j] / N;
-        }
+template<typename T>
+template<typename Byte>
+void AudioProcessor<T>::frameBytes(const Byte * data, std::size_t size, vec2d & frames) const {
+    const unsigned int groupSize = conf.bytesPerSample * conf.numberOfChannels; // bytes of single sample from every channel
+    if(size % groupSize){
+        throw AudioProcessorException("Invalid size of input audio buffer.");
     }
-}
 
-auto AudioProcessor::frameSamples(MatrixMath::vec & sampleData) const -> MatrixMath::vec2d {
+    const std::size_t numSamples = size / groupSize;
+    const unsigned int frameLength = plan->frameLength;
+    const unsigned int frameStep = plan->frameStep;
+    if(numSamples <= frameLength){
+        throw AudioProcessorException("Audio buffer is shorter than single frame.");
+    }
 
-    const unsigned int frameLength = static_cast<unsigned int>(round(conf.framingSize / static_cast<long double>(1000) * conf.sampleRate)); // in num samples
-    const unsigned int frameStep = static_cast<unsigned int>(round(conf.framingStride / static_cast<long double>(1000) * conf.sampleRate)); // in num samples
-    const unsigned int numFrames = static_cast<unsigned int>(ceil((sampleData.size() - frameLength) / static_cast<long double>(frameStep)));
+    // every frame starts before numSamples - frameLength
+    const std::size_t numFrames = (numSamples - frameLength + frameStep - 1) / frameStep; // ceil((numSamples - length) / step)
+    const std::size_t numUsedSamples = (numFrames - 1) * frameStep + frameLength;
+    frames.resize(numFrames, frameLength); // every element is written below
 
-    // make sure there is valid number of samples to perform framing
-    // if there is not then add zeros to the end to make it valid
-    const int paddingToAppend = (sampleData.size() - frameLength) % frameStep;
-    if(paddingToAppend){
-        MatrixMath::vec zeros(paddingToAppend, 0);
-        sampleData.insert(sampleData.end(), zeros.begin(), zeros.end());
-    }
+    T lastSample = 0;
+    for(std::size_t n = 0; n < numUsedSamples; n++){
+        // translate all channel data into mono signal by using average of samples from all channels
+        const Byte * group = data + n * groupSize;
+        T sumSignals = 0;
+        for(unsigned int k = 0; k < conf.numberOfChannels; k++){
+            sumSignals += decodeSample(group + k * conf.bytesPerSample);
+        }
+        const T sample = sumSignals / static_cast<T>(conf.numberOfChannels);
 
-    MatrixMath::vec2d frames(numFrames, MatrixMath::vec(frameLength, 0));
-    for(unsigned int i = 0, j = 0; i < numFrames; i++, j+=frameStep){
-        std::copy(sampleData.begin() + j, sampleData.begin() + j + frameLength, frames[i].begin());
-    }
+        // apply pre emphasis filter to amplify high frequencies and increase s/n ratio
+        lastSample = sample - conf.emphasisCoeff * lastSample;
 
-    return frames;
+        // copy sample into every frame that contains it
+        const std::size_t firstFrame = n >= frameLength ? (n - frameLength) / frameStep + 1 : 0;
+        const std::size_t lastFrame = std::min(n / frameStep, numFrames - 1);
+        for(std::size_t i = firstFrame; i <= lastFrame; i++){
+            frames(i, n - i * frameStep) = lastSample;
+        }
+    }
 }
 
-void AudioProcessor::preEmphasis(MatrixMath::vec & sampleData) const {
-    for(unsigned int i = 1; i < sampleData.size(); i++){
-        sampleData[i] = sampleData[i] - conf.emphasisCoeff * sampleData[i - 1];
+template<typename T>
+void AudioProcessor<T>::frameBuffer(const unsigned char * data, std::size_t size, vec2d & frames) const {
+    if(!plan){
+        throw AudioProcessorException("Invalid audio configuration.");
     }
+    frameBytes(data, size, frames);
 }
 
-void AudioProcessor::hammingWindow(MatrixMath::vec2d & frames) const {
-    for(unsigned int i = 0; i < frames.size(); i++){
-        for(unsigned int j = 0; j < frames[i].size(); j++){
-            frames[i][j] *= 0.54L - 0.46L*cos((2*3.14159265358979323846264338328L*j)/static_cast<long double>((frames[i].size()-1)));
-        }
+template<typename T>
+void AudioProcessor<T>::applyWindow(vec2d & frames) const {
+    if(conf.window == WindowFunction::Rectangular)
+        return;
+
+    for(std::size_t i = 0; i < frames.rows(); i++){
+        SimdKernels::multiply(frames.row(i), plan->window->data(), frames.cols());
     }
 }
-
-void AudioProcessor::filterBanks(MatrixMath::vec2d & v) const {
-    const long double lowFreqMel = 0;
-    const long double highFreqMel = hzToMel(conf.sampleRate / 2);
-    MatrixMath::vec points = MatrixMath::linspace(lowFreqMel, highFreqMel, conf.numberOfFilterBanks + 2); // mel points equally spaced
+template<typename T>
+auto AudioProcessor<T>::buildFilterBanks(const config & c) -> std::vector<typename Plan::MelFilter> {
+    const T lowFreqMel = 0;
+    const T highFreqMel = hzToMel(c.sampleRate / 2);
+    vec points = Math::linspace(lowFreqMel, highFreqMel, c.numberOfFilterBanks + 2); // mel points equally spaced
     melToHz(points); // convert mel space into hz space
 
     for(unsigned int i = 0; i < points.size(); i++)
-        points[i] = floor((conf.NFFT + 1) * points[i] / conf.sampleRate);
-
-    MatrixMath::vec2d fBank(conf.numberOfFilterBanks, MatrixMath::vec(static_cast<int>(floor(conf.NFFT / 2 + 1)), 0));
+        points[i] = floor((c.NFFT + 1) * points[i] / c.sampleRate);
 
-    for(unsigned int i = 1; i < conf.numberOfFilterBanks + 1; i++){
+    // every filter is nonzero only between neighbouring points so keep only that span
+    std::vector<typename Plan::MelFilter> melFilters(c.numberOfFilterBanks);
+    for(unsigned int i = 1; i < c.numberOfFilterBanks + 1; i++){
         unsigned int fMinus = static_cast<int>(points[i - 1]);
         unsigned int f = static_cast<int>(points[i]);
         unsigned int fPlus = static_cast<int>(points[i + 1]);
 
+        typename Plan::MelFilter & filter = melFilters[i - 1];
+        filter.firstBin = fMinus;
+        filter.weights.assign(fPlus > fMinus ? fPlus - fMinus : 0, 0);
+
         for(unsigned int j = fMinus; j < f; j++)
-            fBank[i - 1][j] = (j - points[i - 1]) / (points[i] - points[i - 1]);
+            filter.weights[j - fMinus] = (j - points[i - 1]) / (points[i] - points[i - 1]);
         for(unsigned int j = f; j < fPlus; j++)
-            fBank[i - 1][j] = (points[i + 1] - j) / (points[i + 1] - points[i]);
+            filter.weights[j - fMinus] = (points[i + 1] - j) / (points[i + 1] - points[i]);
     }
+    return melFilters;
+}
 
-    MatrixMath::transposeMatrix(fBank);
-    MatrixMath::dotMatrix(v, fBank);
-    MatrixMath::stabilizeMatrix(v);
+template<typename T>
+void AudioProcessor<T>::filterBanks(const vec2d & v, vec2d & res) const {
+    const std::vector<typename Plan::MelFilter> & melFilters = plan->melFilters;
+
+    for(std::size_t i = 0; i < v.rows(); i++){
+        const T * power = v.row(i);
+        T * bands = res.row(i);
+        for(std::size_t b = 0; b < melFilters.size(); b++){
+            const typename Plan::MelFilter & filter = melFilters[b];
+            const T * bins = power + filter.firstBin;
+            T sum = 0;
+            for(std::size_t j = 0; j < filter.weights.size(); j++){
+                sum += bins[j] * filter.weights[j];
+            }
 
-    //convert result to dB
-    for(unsigned int i = 0; i < v.size(); i++){
-        for(unsigned int j = 0; j < v[i].size(); j++){
-            v[i][j] = 20 * log10(v[i][j]);
+            // stabilize and convert result to dB
+            if(sum == 0)
+                sum = std::numeric_limits<T>::epsilon();
+            bands[b] = 20 * log10(sum);
         }
     }
 }
 
-void AudioProcessor::sinLiftMatrix(MatrixMath::vec2d & v) const {
-    MatrixMath::vec liftRow(v[0].size());
-    for(unsigned int i = 0; i < liftRow.size(); i++){
-        liftRow[i] = 1 + (conf.cepLifter / 2L) * sin(3.14159265358979323846264338328L * i / static_cast<long double>(conf.cepLifter));
+template<typename T>
+auto AudioProcessor<T>::buildDCT(const config & c) -> typename Math::DCTPlan {
+    const unsigned int numCoeffs = c.lastMFCC - c.firstMFCC + 1;
+
+    // sinusoidal lifter is indexed by position among kept coefficients
+    vec liftRow;
+    if(c.sinLift){
+        liftRow.resize(numCoeffs);
+        for(unsigned int i = 0; i < liftRow.size(); i++){
+            liftRow[i] = 1 + (c.cepLifter / 2) * sin(3.14159265358979323846264338328L * i / static_cast<long double>(c.cepLifter));
+        }
     }
 
-    for(unsigned int i = 0; i < v.size(); i++){
-        for(unsigned int j = 0; j < v[i].size(); j++){
-            v[i][j]*=liftRow[j];
+    return typename Math::DCTPlan(c.numberOfFilterBanks, c.firstMFCC - 1, numCoeffs, liftRow);
+}
+
+template<typename T>
+void AudioProcessor<T>::processFrames(Workspace & workspace) const {
+    vec2d & frames = workspace.frames;
+    const std::size_t numFrames = frames.rows();
+    const std::size_t numBins = plan->fft.size() / 2 + 1;
+    const std::size_t numFeatures = conf.MFCC ? plan->dct.numCoeffs() : plan->melFilters.size();
+
+    // buffers only grow, so they are reallocated only when clip is longer than every previous one
+    workspace.power.resize(numFrames, numBins);
+    workspace.bands.resize(conf.MFCC ? numFrames : 0, plan->melFilters.size());
+    workspace.features.resize(numFrames, numFeatures);
+
+    workspace.chunkSize = numFrames;
+    if(threadPool)
+        workspace.chunkSize = std::max<std::size_t>(16, numFrames / (4 * threadPool->size()));
+    const std::size_t numChunks = (numFrames + workspace.chunkSize - 1) / workspace.chunkSize;
+    workspace.fftBuffers.resize(numChunks * (plan->fft.size() / 2));
+
+    // every frame is processed independently so any split into chunks gives the same result
+    // captures fit into std::function without allocating
+    auto processChunk = [this, &workspace](std::size_t begin, std::size_t end){
+        const std::size_t rows = end - begin;
+        vec2d chunk = workspace.frames.view(begin, rows, 0, workspace.frames.cols());
+        vec2d power = workspace.power.view(begin, rows, 0, workspace.power.cols());
+        vec2d features = workspace.features.view(begin, rows, 0, workspace.features.cols());
+        std::complex<T> * buffer = workspace.fftBuffers.data() + begin / workspace.chunkSize * (plan->fft.size() / 2);
+
+        // apply hamming window to each frame to reduce spectral leakage
+        applyWindow(chunk);
+
+        // get power spectrum of each frame
+        Math::fftMatrix(chunk, plan->fft, power, buffer);
+
+        // apply triangular filters on Mel scale to extract frequency bands
+        // apply MFCC if necessary
+        // only kept coefficients are computed and liftering is already included in DCT plan
+        if(conf.MFCC){
+            vec2d bands = workspace.bands.view(begin, rows, 0, workspace.bands.cols());
+            filterBanks(power, bands);
+            Math::dctMatrix(bands, plan->dct, features);
+        }
+        else{
+            filterBanks(power, features);
         }
+    };
+
+    if(threadPool){
+        threadPool->parallelFor(numFrames, workspace.chunkSize, processChunk);
+    }
+    else{
+        processChunk(0, numFrames);
     }
 }
 
-auto AudioProcessor::processBuffer(const byteVec & buffer) const -> MatrixMath::vec2d {
-    if(!validateConfig()){
-        throw AudioProcessorException("Invalid audio configuration.");
+template<typename T>
+void AudioProcessor<T>::finishSpectogram(Workspace & workspace) const {
+    vec2d & features = workspace.features;
+    if(conf.normalize){
+        // only mean is subtracted, same as normalizeMatrixByColumns
+        Math::meansMatrixByColumns(features, workspace.means);
+        Math::subtractMatrixByRows(features, workspace.means);
     }
 
-    // firstly, concatenate single bytes into audio samples
-    MatrixMath::vec vectorData = bytesToSamples(buffer);
+    workspace.spectogram.resize(features.cols(), features.rows());
+    Math::transposeMatrix(features, workspace.spectogram);
 
-    // now translate all channel data into mono signal by using average of samples from all channels
-    channelsToMono(vectorData);
+    finishTransposed(workspace.spectogram);
+}
 
-    // apply pre emphasis filter to amplify high frequencies and increase s/n ratio
-    preEmphasis(vectorData);
+template<typename T>
+void AudioProcessor<T>::finishTransposed(vec2d & features) const {
+    if(conf.rescale){
+        Math::rescaleMatrix(features, conf.rescaleMin, conf.rescaleMax);
+    }
+}
+
+template<typename T>
+template<typename Byte>
+void AudioProcessor<T>::process(const Byte * data, std::size_t size, Workspace & workspace, Stats * stats) const {
+    if(!plan){
+        throw AudioProcessorException("Invalid audio configuration.");
+    }
+
+    typedef std::chrono::steady_clock clock;
+    const clock::time_point start = clock::now();
+    const std::size_t capacity = workspace.capacityBytes();
 
     // split audio samples into frames as frequencies are stationary over short periods of time
     // used to get good frequency contours of the signal
-    MatrixMath::vec2d matrixData = frameSamples(vectorData);
+    frameBytes(data, size, workspace.frames);
+    const clock::time_point framed = clock::now();
+
+    processFrames(workspace);
+    const clock::time_point processed = clock::now();
+
+    finishSpectogram(workspace);
+    const clock::time_point finished = clock::now();
+
+    if(stats){
+        *stats = Stats();
+        stats->framingSeconds = std::chrono::duration<double>(framed - start).count();
+        stats->featuresSeconds = std::chrono::duration<double>(processed - framed).count();
+        stats->finishSeconds = std::chrono::duration<double>(finished - processed).count();
+        stats->totalSeconds = std::chrono::duration<double>(finished - start).count();
+        stats->audioSeconds = static_cast<double>(size / (conf.bytesPerSample * conf.numberOfChannels)) / conf.sampleRate;
+        stats->numFrames = workspace.frames.rows();
+        stats->numFeatures = workspace.spectogram.rows();
+        stats->allocatedBytes = workspace.capacityBytes() - capacity;
+        stats->peakMatrixBytes = workspace.peakMatrixBytes();
+    }
+}
+
+template<typename T>
+auto AudioProcessor<T>::processBuffer(const byteVec & buffer, Stats * stats) const -> vec2d {
+    Workspace workspace;
+    process(buffer.data(), buffer.size(), workspace, stats);
+    return std::move(workspace.spectogram);
+}
 
-    // apply hamming window to each frame to reduce spectral leakage
-    hammingWindow(matrixData);
+template<typename T>
+auto AudioProcessor<T>::processBuffer(const unsigned char * data, std::size_t size, Stats * stats) const -> vec2d {
+    Workspace workspace;
+    process(data, size, workspace, stats);
+    return std::move(workspace.spectogram);
+}
 
-    // get frequency domain data from each frame
-    MatrixMath::fftMatrix(matrixData, conf.NFFT);
+template<typename T>
+auto AudioProcessor<T>::processBuffer(const byteVec & buffer, Workspace & workspace, Stats * stats) const -> const vec2d & {
+    process(buffer.data(), buffer.size(), workspace, stats);
+    return workspace.spectogram;
+}
 
-    // convert magnitude to power spectrum
-    magnitudeToPower(matrixData);
+template<typename T>
+auto AudioProcessor<T>::processBuffer(const unsigned char * data, std::size_t size, Workspace & workspace, Stats * stats) const -> const vec2d & {
+    process(data, size, workspace, stats);
+    return workspace.spectogram;
+}
+
+template<typename T>
+void AudioProcessor<T>::pushBytes(const unsigned char * data, std::size_t size){
+    if(!plan){
+        throw AudioProcessorException("Invalid audio configuration.");
+    }
+
+    typedef std::chrono::steady_clock clock;
+    const clock::time_point start = clock::now();
+
+    const unsigned int groupSize = conf.bytesPerSample * conf.numberOfChannels; // bytes of single sample from every channel
+
+    // complete sample group split between previous and current chunk
+    if(!streamPartial.empty()){
+        const std::size_t missing = std::min<std::size_t>(groupSize - streamPartial.size(), size);
+        streamPartial.insert(streamPartial.end(), data, data + missing);
+        data += missing;
+        size -= missing;
+        if(streamPartial.size() < groupSize)
+            return;
+        streamPushSample(streamPartial.data());
+        streamPartial.clear();
+    }
+
+    // convert to mono and apply pre emphasis, carrying filter state between chunks
+    const std::size_t numGroups = size / groupSize;
+    streamSamples.reserve(streamSamples.size() + numGroups);
+    for(std::size_t i = 0; i < numGroups; i++){
+        streamPushSample(data + i * groupSize);
+    }
+    streamPartial.assign(data + numGroups * groupSize, data + size);
+
+    // process every frame whose samples are all available
+    const unsigned int length = plan->frameLength;
+    const unsigned int step = plan->frameStep;
+    const std::size_t streamEnd = streamOffset + streamSamples.size();
+    std::size_t numFrames = 0;
+    while((streamNextFrame + numFrames) * step + length < streamEnd)
+        numFrames++;
+    if(numFrames == 0){
+        streamStats.framingSeconds += std::chrono::duration<double>(clock::now() - start).count();
+        return;
+    }
+
+    const std::size_t capacity = streamWorkspace.capacityBytes();
+    vec2d & frames = streamWorkspace.frames;
+    frames.resize(numFrames, length);
+    for(std::size_t i = 0; i < numFrames; i++){
+        const T * first = streamSamples.data() + (streamNextFrame + i) * step - streamOffset;
+        std::copy(first, first + length, frames.row(i));
+    }
+    const clock::time_point framed = clock::now();
+
+    processFrames(streamWorkspace);
+    const vec2d & features = streamWorkspace.features;
+    streamStats.allocatedBytes += streamWorkspace.capacityBytes() - capacity;
+    streamStats.peakMatrixBytes = std::max(streamStats.peakMatrixBytes, streamWorkspace.peakMatrixBytes());
+
+    streamNumFeatures = features.cols();
+    for(std::size_t i = 0; i < numFrames; i++){
+        const std::size_t frame = streamNextFrame + i;
+        if(frame / streamBlockFrames >= streamBlocks.size()){
+            streamBlocks.emplace_back(streamBlockFrames, streamNumFeatures);
+            streamStats.addMatrix(streamBlockFrames, streamNumFeatures);
+        }
+        std::copy(features.row(i), features.row(i) + streamNumFeatures, streamBlocks[frame / streamBlockFrames].row(frame % streamBlockFrames));
+    }
+    streamNextFrame += numFrames;
 
-    // apply triangular filters on Mel scale to extract frequency bands
-    filterBanks(matrixData);
+    // drop samples that won't be used by any further frame
+    const std::size_t consumed = std::min(streamNextFrame * step, streamEnd) - streamOffset;
+    streamSamples.erase(streamSamples.begin(), streamSamples.begin() + consumed);
+    streamOffset += consumed;
+
+    streamStats.framingSeconds += std::chrono::duration<double>(framed - start).count();
+    streamStats.featuresSeconds += std::chrono::duration<double>(clock::now() - framed).count();
+}
+
+template<typename T>
+std::size_t AudioProcessor<T>::popFrames(vec2d & frames){
+    const std::size_t numFrames = streamNextFrame - streamPopped;
+    frames = vec2d(numFrames, streamNumFeatures);
+    for(std::size_t i = 0; i < numFrames; i++){
+        const std::size_t frame = streamPopped + i;
+        const T * features = streamBlocks[frame / streamBlockFrames].row(frame % streamBlockFrames);
+        std::copy(features, features + streamNumFeatures, frames.row(i));
+    }
+    streamPopped = streamNextFrame;
+    return numFrames;
+}
+
+template<typename T>
+auto AudioProcessor<T>::finish(Stats * stats) -> vec2d {
+    typedef std::chrono::steady_clock clock;
+    const clock::time_point start = clock::now();
+
+    if(!streamPartial.empty()){
+        resetStream();
+        throw AudioProcessorException("Invalid size of input audio buffer.");
+    }
+    if(streamNextFrame == 0){
+        resetStream();
+        throw AudioProcessorException("Audio buffer is shorter than single frame.");
+    }
 
-    // apply MFCC if necessary
-    if(conf.MFCC){
-        MatrixMath::dctMatrix(matrixData);
+    const std::size_t numFrames = streamNextFrame;
+    const std::size_t numFeatures = streamNumFeatures;
 
-        // erase not needed coeffs
-        unsigned int numFromStart = conf.firstMFCC-1;
-        unsigned int numToEnd = matrixData[0].size() - conf.lastMFCC;
-        MatrixMath::eraseColumnsMatrix(matrixData, numFromStart, numToEnd);
+    // same as normalizeMatrixByColumns, means are accumulated frame by frame
+    vec means(numFeatures, 0);
+    if(conf.normalize){
+        for(std::size_t frame = 0; frame < numFrames; frame++){
+            const T * features = streamBlocks[frame / streamBlockFrames].row(frame % streamBlockFrames);
+            for(std::size_t j = 0; j < numFeatures; j++){
+                means[j] += features[j];
+            }
+        }
+        for(std::size_t j = 0; j < numFeatures; j++){
+            means[j] = means[j] / numFrames;
+        }
+    }
 
-        if(conf.sinLift){
-            sinLiftMatrix(matrixData);
+    // normalize and transpose blocks straight into spectogram, every block is freed as soon as it's copied
+    // so stream and spectogram are never both fully in memory
+    vec2d spectogram(numFeatures, numFrames);
+    const std::size_t tile = 16;
+    for(std::size_t b = 0; b < streamBlocks.size(); b++){
+        const std::size_t firstFrame = b * streamBlockFrames;
+        const std::size_t blockFrames = std::min(streamBlockFrames, numFrames - std::min(numFrames, firstFrame));
+        for(std::size_t i0 = 0; i0 < blockFrames; i0 += tile){
+            const std::size_t iEnd = std::min(i0 + tile, blockFrames);
+            for(std::size_t j = 0; j < numFeatures; j++){
+                T * row = spectogram.row(j) + firstFrame;
+                for(std::size_t i = i0; i < iEnd; i++){
+                    row[i] = streamBlocks[b](i, j) - means[j];
+                }
+            }
         }
+        vec2d().swap(streamBlocks[b]);
     }
+    Stats s = streamStats;
+    const std::size_t numSamples = streamOffset + streamSamples.size();
+    resetStream();
 
-    if(conf.normalize)
-        MatrixMath::normalizeMatrixByColumns(matrixData);
+    finishTransposed(spectogram);
 
-    MatrixMath::transposeMatrix(matrixData);
+    if(stats){
+        s.finishSeconds = std::chrono::duration<double>(clock::now() - start).count();
+        s.totalSeconds = s.framingSeconds + s.featuresSeconds + s.finishSeconds;
+        s.audioSeconds = static_cast<double>(numSamples) / conf.sampleRate;
+        s.numFrames = numFrames;
+        s.numFeatures = numFeatures;
+        s.addMatrix(numFeatures, numFrames);
+        *stats = s;
+    }
+    return spectogram;
+}
 
-    if(conf.rescale){
-        MatrixMath::rescaleMatrix(matrixData, conf.rescaleMin, conf.rescaleMax);
+template<typename T>
+void AudioProcessor<T>::resetStream(){
+    streamPartial.clear();
+    streamLastSample = 0;
+    streamSamples.clear();
+    streamOffset = 0;
+    streamNextFrame = 0;
+    streamBlocks.clear();
+    streamNumFeatures = 0;
+    streamPopped = 0;
+    streamStats = Stats();
+}
+
+template<typename T>
+void AudioProcessor<T>::reserveStream(std::size_t numBytes){
+    if(!plan)
+        return;
+
+    const std::size_t numSamples = numBytes / (conf.bytesPerSample * conf.numberOfChannels);
+    const unsigned int length = plan->frameLength;
+    const unsigned int step = plan->frameStep;
+    const std::size_t numFrames = numSamples > length ? (numSamples - length + step - 1) / step : 0;
+    const std::size_t numFeatures = conf.MFCC ? plan->dct.numCoeffs() : plan->melFilters.size();
+
+    const std::size_t numBlocks = (numFrames + streamBlockFrames - 1) / streamBlockFrames;
+    streamBlocks.reserve(numBlocks);
+    while(streamBlocks.size() < numBlocks){
+        streamBlocks.emplace_back(streamBlockFrames, numFeatures);
+        streamStats.addMatrix(streamBlockFrames, numFeatures);
     }
-    cout << "Shape: ";
-    cout << matrixData.size() << " " << matrixData[0].size() << endl;
+}
+
+template<typename T>
+void AudioProcessor<T>::streamPushSample(const unsigned char * group){
+    T sumSignals = 0;
+    for(unsigned int k = 0; k < conf.numberOfChannels; k++){
+        sumSignals += decodeSample(group + k * conf.bytesPerSample);
+    }
+    const T sample = sumSignals / static_cast<T>(conf.numberOfChannels);
 
-    return matrixData;
+    streamLastSample = sample - conf.emphasisCoeff * streamLastSample;
+    streamSamples.push_back(streamLastSample);
 }
+
+template class MatrixMath<float>;
+template class MatrixMath<double>;
+template class MatrixMath<long double>;
+template class AudioProcessor<float>;
+template class AudioProcessor<double>;
+template class AudioProcessor<long double>;
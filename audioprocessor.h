@@ -4,19 +4,145 @@
 #include <vector>
 #include <exception>
 #include <complex>
-#include <valarray>
+#include <cmath>
+#include <memory>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include "matrix.h"
+
+class ThreadPool;
+
+/**
+ * @brief Window functions that can be applied to frames before FFT.
+ */
+enum class WindowFunction{
+    Hamming,
+    Hann,
+    Blackman,
+    Rectangular
+};
 
+/**
+ * @brief Matrix and vector operations used by AudioProcessor.
+ * @tparam T Scalar type used for computations, i.e float, double or long double.
+ */
+template<typename T>
 class MatrixMath{
-private:
+public:
+    typedef std::vector<T> vec;
+    typedef Matrix<T> vec2d;
+    typedef std::vector<std::complex<T>> cvec;
+
+    /**
+     * @brief Precomputed tables for in place, iterative fast fourier transformation of fixed size.
+     *
+     * Build it once per NFFT and reuse it for every frame, transform itself does not allocate memory.
+     */
+    class FFTPlan{
+    private:
+        unsigned int N = 0;
+        std::vector<unsigned int> bitReversed; //!< Bit reversed index of every input element.
+        cvec twiddles; //!< exp(-2*pi*i*k/N) for k in [0, N/2).
+
+    public:
+        /**
+         * @brief Create plan for FFT of given size.
+         * @param size Number of points of FFT, must be power of two.
+         */
+        FFTPlan(unsigned int size = 0);
+
+        /**
+         * @brief Get number of points of FFT.
+         * @return Number of points of FFT.
+         */
+        unsigned int size() const {return N;}
+
+        /**
+         * @brief Perform fast fourier transformation in place.
+         * @param data Array of size() complex samples and also a result of FFT after function call.
+         */
+        void transform(std::complex<T> * data) const;
+    };
+
     /**
-     * @brief Perform fast fourier transformation on given complex valarray.
-     * @param complexFrame Samples of real signal and also a result of FFT after function call.
-     */
-    static void fft(std::valarray<std::complex<long double>> & complexFrame);
+     * @brief Precomputed tables for fast fourier transformation of real signal.
+     *
+     * Real signal of N points is packed into N/2 complex points, transformed using FFTPlan of half size
+     * and then split back into left half of the spectrum of real signal.
+     */
+    class RealFFTPlan{
+    private:
+        unsigned int N = 0;
+        FFTPlan halfPlan; //!< Plan for FFT of N/2 points.
+        cvec twiddles; //!< exp(-2*pi*i*k/N) for k in [0, N/2).
+
+    public:
+        /**
+         * @brief Create plan for FFT of real signal of given size.
+         * @param size Number of points of FFT, must be power of two.
+         */
+        RealFFTPlan(unsigned int size = 0);
+
+        /**
+         * @brief Get number of points of FFT.
+         * @return Number of points of FFT.
+         */
+        unsigned int size() const {return N;}
+
+        /**
+         * @brief Compute scaled power spectrum |X|^2 * scale of given real signal.
+         * @param samples Real signal, appended with zeros or truncated to size() samples.
+         * @param numSamples Number of samples in signal.
+         * @param power Array of size()/2+1 elements that receives left half of power spectrum, may be the same array as samples.
+         * @param buffer Work buffer of size()/2 elements.
+         * @param scale Value to multiply every element of power spectrum by.
+         */
+        void powerSpectrum(const T * samples, unsigned int numSamples, T * power,
+                           std::complex<T> * buffer, T scale) const;
+    };
 
-public:
-    typedef std::vector<long double> vec;
-    typedef std::vector<std::vector<long double>> vec2d;
+    /**
+     * @brief Precomputed cosine basis of discrete cosine transform (DCT-II) restricted to chosen range of coefficients.
+     *
+     * Every basis row already contains DCT normalization and optional per coefficient weight (i.e sinusoidal lifter).
+     */
+    class DCTPlan{
+    private:
+        unsigned int N = 0;
+        unsigned int firstCoeff = 0;
+        Matrix<T> basis; //!< Row k holds weighted cosines of coefficient firstCoeff + k.
+
+    public:
+        /**
+         * @brief Create plan for DCT of given size.
+         * @param size Number of input elements.
+         * @param first Index of first coefficient to compute.
+         * @param numCoeffs Number of coefficients to compute.
+         * @param weights Weight of every computed coefficient, empty if coefficients are not weighted.
+         */
+        DCTPlan(unsigned int size = 0, unsigned int first = 0, unsigned int numCoeffs = 0, const vec & weights = vec());
+
+        /**
+         * @brief Get number of input elements.
+         * @return Number of input elements.
+         */
+        unsigned int size() const {return N;}
+
+        /**
+         * @brief Get number of computed coefficients.
+         * @return Number of computed coefficients.
+         */
+        unsigned int numCoeffs() const {return static_cast<unsigned int>(basis.rows());}
+
+        /**
+         * @brief Compute chosen DCT coefficients of given array.
+         * @param in Array of size() elements.
+         * @param out Array of numCoeffs() elements that receives result of operation.
+         */
+        void transform(const T * in, T * out) const;
+    };
 
     /**
      * @brief Perform transpose operation on given matrix.
@@ -24,6 +150,13 @@ public:
      */
     static void transposeMatrix(vec2d & v);
 
+    /**
+     * @brief Transpose given matrix into another one.
+     * @param v Matrix to transpose.
+     * @param result Matrix of v.cols() rows and v.rows() columns that receives transposed matrix.
+     */
+    static void transposeMatrix(const vec2d & v, vec2d & result);
+
     /**
      * @brief Perform dot product on two matrices.
      * @param first First matrix in dot product and also result of dot product after function call.
@@ -58,7 +191,7 @@ public:
      * @param minVal Lowest value in matrix.
      * @param maxVal Highest value in matrix.
      */
-    static void rescaleMatrix(vec2d & v, long double minVal, long double maxVal);
+    static void rescaleMatrix(vec2d & v, T minVal, T maxVal);
 
     /**
      * @brief Compute mean of every column in matrix.
@@ -67,6 +200,13 @@ public:
      */
     static vec meansMatrixByColumns(const vec2d & v);
 
+    /**
+     * @brief Compute mean of every column in matrix into existing vector.
+     * @param v Matrix to compute means.
+     * @param means Vector that receives mean values of matrix v, resized to number of columns.
+     */
+    static void meansMatrixByColumns(const vec2d & v, vec & means);
+
     /**
      * @brief Get minimum values from each column in matrix.
      * @param v Matrix to get min values.
@@ -92,38 +232,75 @@ public:
      * @param Vector to search.
      * @return Smallest value in matrix.
      */
-    static long double minMatrix(const MatrixMath::vec2d & v);
+    static T minMatrix(const vec2d & v);
 
     /**
      * @brief Find biggest value in matrix.
      * @param Vector to search.
      * @return Biggest value in matrix.
      */
-    static long double maxMatrix(const MatrixMath::vec2d & v);
+    static T maxMatrix(const vec2d & v);
+
+    /**
+     * @brief Compute power spectrum of given vector using fast fourier transformation.
+     * @param frame Samples of real signal and also left half of it's power spectrum after function call.
+     * @param plan FFT plan of requested number of points.
+     * @param buffer Work buffer of plan.size()/2 elements.
+     */
+    static void fftVector(vec & frame, const RealFFTPlan & plan, cvec & buffer);
+
+    /**
+     * @brief Compute power spectrum of every row in given matrix using fast fourier transformation.
+     * @param frames Matrix of rows and also result of operation after function call.
+     * @param plan FFT plan of requested number of points.
+     */
+    static void fftMatrix(vec2d & frames, const RealFFTPlan & plan);
 
     /**
-     * @brief Perform fast fourier transformation on given vector.
-     * @param frame Samples of real signal and also a result of FFT after function call.
+     * @brief Compute power spectrum of every row in given matrix into another one.
+     * @param frames Matrix of rows.
+     * @param plan FFT plan of requested number of points.
+     * @param power Matrix of frames.rows() rows and plan.size()/2+1 columns that receives result of operation.
+     * @param buffer Work buffer of plan.size()/2 elements.
      */
-    static void fftVector(MatrixMath::vec & frame, unsigned int NFFT);
+    static void fftMatrix(const vec2d & frames, const RealFFTPlan & plan, vec2d & power, std::complex<T> * buffer);
 
+private:
     /**
-     * @brief Perform fast fourier transformation for every row in given matrix.
-     * @param frames Matrix of rows and also result of FFT after function call.
+     * @brief Compute discrete cosine transform of given array.
+     * @param in Array of N elements to compute DCT.
+     * @param out Array of N elements that receives result of operation.
+     * @param N Number of elements.
      */
-    static void fftMatrix(MatrixMath::vec2d & frames, unsigned int NFFT);
+    static void dct(const T * in, T * out, unsigned int N);
 
+public:
     /**
      * @brief Compute discrete cosine transform on given vector.
      * @param v Vector to compute DCT and result of operation after function call.
      */
-    static void dctVector(MatrixMath::vec & v);
+    static void dctVector(vec & v);
 
     /**
      * @brief Compute discrete cosine transform on every row of given matrix.
      * @param Matrix to compute DCT and result of operation after function call.
      */
-    static void dctMatrix(MatrixMath::vec2d & frames);
+    static void dctMatrix(vec2d & frames);
+
+    /**
+     * @brief Compute chosen discrete cosine transform coefficients of every row of given matrix.
+     * @param frames Matrix to compute DCT and result of operation after function call.
+     * @param plan DCT plan of size equal to number of columns in matrix.
+     */
+    static void dctMatrix(vec2d & frames, const DCTPlan & plan);
+
+    /**
+     * @brief Compute chosen discrete cosine transform coefficients of every row of given matrix into another one.
+     * @param frames Matrix to compute DCT.
+     * @param plan DCT plan of size equal to number of columns in matrix.
+     * @param result Matrix of frames.rows() rows and plan.numCoeffs() columns that receives result of operation.
+     */
+    static void dctMatrix(const vec2d & frames, const DCTPlan & plan, vec2d & result);
 
     /**
      * @brief Create vector of equally spaced values.
@@ -132,7 +309,16 @@ public:
      * @param numPoints Number of elements in vector.
      * @return Vector of equally spaced values.
      */
-    static vec linspace(long double low, long double high, unsigned int numPoints);
+    static vec linspace(T low, T high, unsigned int numPoints);
+
+    /**
+     * @brief Get coefficients of window function. Every table is computed once per (type, length)
+     * and shared between all callers, so applying a window costs single multiplication per sample.
+     * @param type Window function.
+     * @param length Number of coefficients.
+     * @return Window coefficients, reference stays valid until end of program.
+     */
+    static const vec & window(WindowFunction type, unsigned int length);
 
 };
 
@@ -142,23 +328,34 @@ private:
   const char* w;
 public:
   AudioProcessorException(const char* what):w(what){}
-  virtual const char* what() const
+  virtual const char* what() const noexcept
   {
     return w;
   }
 };
 
+/**
+ * @brief Converts raw audio/pcm buffers into MSFB or MFCC spectograms.
+ * @tparam T Scalar type used for computations, i.e float, double or long double.
+ */
+template<typename T>
 class AudioProcessor
 {
 public:
+    typedef MatrixMath<T> Math;
+    typedef typename Math::vec vec;
+    typedef typename Math::vec2d vec2d;
+    typedef typename Math::cvec cvec;
+
     typedef std::vector<unsigned int> byteVec;
     struct config{
         unsigned int bytesPerSample = 0;
         unsigned int numberOfChannels = 0;
         unsigned int sampleRate = 0;
-        long double emphasisCoeff = 0;
+        T emphasisCoeff = 0;
         unsigned int framingSize = 0;
         unsigned int framingStride = 0;
+        WindowFunction window = WindowFunction::Hamming;
         unsigned int NFFT = 0;
         unsigned int numberOfFilterBanks = 0;
         bool MFCC = false;
@@ -168,101 +365,272 @@ public:
         unsigned int cepLifter = 0;
         bool normalize = false;
         bool rescale = false;
-        long double rescaleMin = 0;
-        long double rescaleMax = 0;
+        T rescaleMin = 0;
+        T rescaleMax = 0;
+
+        bool operator==(const config & other) const {
+            return bytesPerSample == other.bytesPerSample && numberOfChannels == other.numberOfChannels &&
+                   sampleRate == other.sampleRate && emphasisCoeff == other.emphasisCoeff &&
+                   framingSize == other.framingSize && framingStride == other.framingStride &&
+                   window == other.window && NFFT == other.NFFT && numberOfFilterBanks == other.numberOfFilterBanks &&
+                   MFCC == other.MFCC && firstMFCC == other.firstMFCC && lastMFCC == other.lastMFCC &&
+                   sinLift == other.sinLift && cepLifter == other.cepLifter && normalize == other.normalize &&
+                   rescale == other.rescale && rescaleMin == other.rescaleMin && rescaleMax == other.rescaleMax;
+        }
+        bool operator!=(const config & other) const {return !(*this == other);}
+
+        /**
+         * @brief Get FNV-1a hash of every field. Stable across runs and platforms, so it identifies
+         * parameters spectograms were computed with.
+         * @return Hash of config.
+         */
+        uint64_t hash() const {
+            const double fields[] = {
+                double(bytesPerSample), double(numberOfChannels), double(sampleRate), double(emphasisCoeff),
+                double(framingSize), double(framingStride), double(static_cast<int>(window)), double(NFFT),
+                double(numberOfFilterBanks), double(MFCC), double(firstMFCC), double(lastMFCC), double(sinLift),
+                double(cepLifter), double(normalize), double(rescale), double(rescaleMin), double(rescaleMax)
+            };
+            uint64_t h = 14695981039346656037ull;
+            for(double field : fields){
+                uint64_t bits;
+                std::memcpy(&bits, &field, sizeof(bits));
+                for(unsigned int k = 0; k < sizeof(bits); k++){
+                    h = (h ^ ((bits >> (8 * k)) & 0xFF)) * 1099511628211ull;
+                }
+            }
+            return h;
+        }
+    };
+
+    /**
+     * @brief Everything derived from a valid config that doesn't depend on processed audio.
+     * Plan is immutable once built so it is shared between processors and threads.
+     */
+    struct Plan{
+        /**
+         * @brief Triangular filter stored as it's nonzero part only.
+         */
+        struct MelFilter{
+            unsigned int firstBin = 0; //!< Index of power spectrum bin multiplied by weights[0].
+            vec weights; //!< Weights of consecutive power spectrum bins.
+        };
+
+        unsigned int frameLength = 0; //!< Length of single frame in number of samples.
+        unsigned int frameStep = 0; //!< Distance between beginnings of consecutive frames in number of samples.
+        const vec * window = nullptr; //!< Coefficients of window function.
+        typename Math::RealFFTPlan fft; //!< Plan for FFT of NFFT points.
+        std::vector<MelFilter> melFilters; //!< Filter banks.
+        typename Math::DCTPlan dct; //!< Kept MFCC coefficients with liftering applied.
+    };
+
+    /**
+     * @brief Measurements of single spectogram, filled by processBuffer and finish when requested.
+     * Matrix sizes are computed from shapes of matrices used by stages.
+     */
+    struct Stats{
+        double framingSeconds = 0; //!< Decoding, conversion to mono, pre emphasis and framing.
+        double featuresSeconds = 0; //!< Window, FFT, filter banks and DCT.
+        double finishSeconds = 0; //!< Normalization, transposition and rescaling.
+        double totalSeconds = 0; //!< Wall time of whole processing.
+        double audioSeconds = 0; //!< Duration of processed audio.
+        std::size_t numFrames = 0; //!< Number of frames of spectogram.
+        std::size_t numFeatures = 0; //!< Number of features of single frame.
+        std::size_t allocatedBytes = 0; //!< Bytes allocated by stages, buffers reused from Workspace aren't counted.
+        std::size_t peakMatrixBytes = 0; //!< Bytes of largest matrix used by stages.
+
+        /**
+         * @brief Get processing time relative to duration of audio.
+         * @return Real-time factor, below 1 if audio is processed faster than it plays.
+         */
+        double realTimeFactor() const {return audioSeconds > 0 ? totalSeconds / audioSeconds : 0;}
+
+        /**
+         * @brief Account matrix allocated by a stage.
+         * @param rows Number of rows.
+         * @param cols Number of columns.
+         */
+        void addMatrix(std::size_t rows, std::size_t cols){
+            const std::size_t bytes = rows * cols * sizeof(T);
+            allocatedBytes += bytes;
+            peakMatrixBytes = std::max(peakMatrixBytes, bytes);
+        }
+    };
+
+    /**
+     * @brief Buffers of every stage of processBuffer, owned by caller and kept between calls.
+     * Buffers only grow, so once they fit clips of some length processing clip of the same
+     * or shorter length makes no heap allocations. Workspace may be used by one call at a time only.
+     */
+    class Workspace{
+        friend class AudioProcessor;
+
+        vec2d frames; //!< Samples of every frame, one frame per row.
+        vec2d power; //!< Power spectrum of every frame.
+        vec2d bands; //!< Filter banks of every frame, used only by MFCC as features are filter banks otherwise.
+        vec2d features; //!< Features of every frame, i.e MSFB or MFCC.
+        vec2d spectogram; //!< Result of last call.
+        vec means; //!< Mean of every feature.
+        cvec fftBuffers; //!< FFT work buffer of every chunk of frames, so chunks processed in parallel never share one.
+        std::size_t chunkSize = 0; //!< Number of frames in single chunk.
+
+        /**
+         * @brief Get memory held by workspace.
+         * @return Capacity of every buffer in bytes.
+         */
+        std::size_t capacityBytes() const {
+            return (frames.capacity() + power.capacity() + bands.capacity() + features.capacity() +
+                    spectogram.capacity() + means.capacity()) * sizeof(T) + fftBuffers.capacity() * sizeof(std::complex<T>);
+        }
+
+        /**
+         * @brief Get size of largest matrix of last call.
+         * @return Bytes of largest matrix.
+         */
+        std::size_t peakMatrixBytes() const {
+            std::size_t peak = 0;
+            for(const vec2d * m : {&frames, &power, &bands, &features, &spectogram})
+                peak = std::max(peak, m->rows() * m->cols() * sizeof(T));
+            return peak;
+        }
     };
 
+    /**
+     * @brief Get plan of given config. Recently used plans are cached so setting the same config again is cheap.
+     * @param c Config of plan.
+     * @return Plan of config or null if config is invalid.
+     */
+    static std::shared_ptr<const Plan> getPlan(const config & c);
+
 private:
     config conf;
+    std::shared_ptr<const Plan> plan; //!< Plan of current config, null if config is invalid.
+    ThreadPool * threadPool = nullptr; //!< Threads that process frames, frames are processed serially if null.
+
+    std::vector<unsigned char> streamPartial; //!< Bytes of incomplete sample left from previous pushBytes call.
+    T streamLastSample = 0; //!< Last pre emphasized sample of stream.
+    vec streamSamples; //!< Pre emphasized mono samples not yet consumed by every frame.
+    std::size_t streamOffset = 0; //!< Index of streamSamples[0] in whole stream.
+    std::size_t streamNextFrame = 0; //!< Index of next frame to compute, also number of computed frames.
+    static constexpr std::size_t streamBlockFrames = 256; //!< Number of frames in single block of streamBlocks.
+    std::vector<vec2d> streamBlocks; //!< Computed frames, stored in blocks so they are never reallocated while stream grows.
+    std::size_t streamNumFeatures = 0; //!< Number of features in single computed frame.
+    std::size_t streamPopped = 0; //!< Number of frames already returned by popFrames.
+    Stats streamStats; //!< Measurements of stream accumulated by pushBytes.
+    Workspace streamWorkspace; //!< Buffers of frames computed by pushBytes, kept between calls and streams.
 
     /**
      * @brief Validate configuration struct.
+     * @param c Config to validate.
      * @return True if struct contains valid configuration.
      */
-    bool validateConfig() const;
+    static bool validateConfig(const config & c);
+
+    /**
+     * @brief Build plan of given config without looking into cache.
+     * @param c Config of plan.
+     * @return Plan of config or null if config is invalid.
+     */
+    static std::shared_ptr<const Plan> buildPlan(const config & c);
 
     /**
      * @brief Convert frequency value to Mel scale.
      * @param sample Value to convert.
      * @return Value on Mel scale.
      */
-    static long double hzToMel(long double sample){return 2595*log10l(1 + sample/700);}
+    static T hzToMel(T sample){return 2595*std::log10(1 + sample/700);}
 
     /**
      * @brief Convert vector of frequency values to Mel scale.
      * @param v Vector to convert and also converted values after function call.
      */
-    static void hzToMel(MatrixMath::vec & v){for(unsigned int i = 0; i < v.size(); i++){v[i] = hzToMel(v[i]);}}
+    static void hzToMel(vec & v){for(unsigned int i = 0; i < v.size(); i++){v[i] = hzToMel(v[i]);}}
 
     /**
      * @brief Convert Mel value to frequency.
      * @param sample Value to convert.
      * @return  Value on frequency scale.
      */
-    static long double melToHz(long double sample){return 700*(pow(10, sample/2595) - 1);}
+    static T melToHz(T sample){return 700*(std::pow(static_cast<T>(10), sample/2595) - 1);}
 
     /**
      * @brief Convert vector of Mel values to frequency values.
      * @param v Vector to convert and also converted values after function call.
      */
-    static void melToHz(MatrixMath::vec & v){for(unsigned int i = 0; i < v.size(); i++){v[i] = melToHz(v[i]);}}
+    static void melToHz(vec & v){for(unsigned int i = 0; i < v.size(); i++){v[i] = melToHz(v[i]);}}
+
+    /**
+     * @brief Convert single little endian audio/pcm sample into value.
+     * @param bytes First byte of sample.
+     * @return Value of sample.
+     */
+    template<typename Byte>
+    T decodeSample(const Byte * bytes) const;
 
     /**
-     * @brief Convert audio/pcm bytes into samples.
-     * @param buffer Buffer of bytes to convert.
-     * @return Vector of samples.
+     * @brief Convert audio/pcm bytes into mono samples, apply pre emphasis filter and split them into frames
+     * of specified in config length and stride, all in single pass over the buffer.
+     * @param data Buffer of bytes to convert.
+     * @param size Number of bytes in buffer.
+     * @param frames Matrix that receives single frame in each row, resized to number of frames.
      */
-    MatrixMath::vec bytesToSamples(const byteVec & buffer) const;
+    template<typename Byte>
+    void frameBytes(const Byte * data, std::size_t size, vec2d & frames) const;
 
     /**
-     * @brief Convert stereo (or multi channel) vector of samples into mono signal using mean of channel amplitudes.
-     * @param sampleData Signal to convert and also result of operation after function call.
+     * @brief Compute triangular filters on Mel scale.
+     * @param c Config of filters.
+     * @return Filter banks.
      */
-    void channelsToMono(MatrixMath::vec & sampleData) const;
+    static std::vector<typename Plan::MelFilter> buildFilterBanks(const config & c);
 
     /**
-     * @brief Convert magnitudes of frequency domain signal into power spectrum.
-     * @param magnitudes Magnitudes to convert and also power spectrum after function call.
+     * @brief Compute DCT plan of kept MFCC coefficients.
+     * @param c Config of MFCC.
+     * @return DCT plan.
      */
-    static void magnitudeToPower(MatrixMath::vec2d & magnitudes);
+    static typename Math::DCTPlan buildDCT(const config & c);
 
     /**
-     * @brief Frame given signal into frames of specified in config length and stride.
-     * @param sampleData Samples to frame.
-     * @return Matrix where each row contains single frame.
+     * @brief Convert frames of workspace into features of every frame, i.e MSFB or MFCC.
+     * @param workspace Workspace whose frames are windowed in place and whose features receive result.
      */
-    MatrixMath::vec2d frameSamples(MatrixMath::vec & sampleData) const;
+    void processFrames(Workspace & workspace) const;
 
     /**
-     * @brief Apply pre emphasis filter to given signal.
-     * @param sampleData Input signal and also filtered signal after function call.
+     * @brief Run every stage on buffer, shared by every overload of processBuffer.
+     * @param data Buffer to process.
+     * @param size Number of bytes in buffer.
+     * @param workspace Buffers of stages, spectogram is stored in it.
+     * @param stats Receives measurements if not null.
      */
-    void preEmphasis(MatrixMath::vec & sampleData) const;
+    template<typename Byte>
+    void process(const Byte * data, std::size_t size, Workspace & workspace, Stats * stats) const;
 
     /**
-     * @brief Apply Hamming window function to given matrix of frames.
-     * @param frames Frames to apply Hamming window into and also modified frames after function call.
+     * @brief Apply operations that require features of every frame, i.e normalization, transposition and rescaling.
+     * @param workspace Workspace whose features are turned into spectogram.
      */
-    void hammingWindow(MatrixMath::vec2d & frames) const;
+    void finishSpectogram(Workspace & workspace) const;
 
     /**
-     * @brief Apply triangular filters to given vector.
-     * @param v Vector to apply triangular filters to and result of operation after function call.
+     * @brief Apply operations that require whole spectogram after it was transposed, i.e rescaling.
+     * @param spectogram Transposed features of every frame and also spectogram after function call.
      */
-    void filterBanks(MatrixMath::vec2d & v) const;
+    void finishTransposed(vec2d & spectogram) const;
 
     /**
-     * @brief Apply sinusoidal liftering to given matrix.
-     * @param Matrix to apply liftering to and result of operation after function call
+     * @brief Convert single sample of every channel into mono, apply pre emphasis and append it to stream.
+     * @param group First byte of sample of first channel.
      */
-    void sinLiftMatrix(MatrixMath::vec2d & v) const;
+    void streamPushSample(const unsigned char * group);
 
 public:
     /**
      * @brief Class constructor.
      * @param
      */
-    AudioProcessor(config c = {0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}){setConfig(c);}
+    AudioProcessor(config c = config()){setConfig(c);}
 
     /**
      * @brief Get config of audio processor.
@@ -270,19 +638,125 @@ public:
      */
     config getConfig() const {return conf;}
 
+    /**
+     * @brief Get plan of current config.
+     * @return Plan of current config or null if config is invalid.
+     */
+    std::shared_ptr<const Plan> getPlan() const {return plan;}
+
     /**
      * @brief Set new config of audio processor.
      * @param c Config to set.
      */
-    void setConfig(config c){conf = c;}
+    void setConfig(config c);
+
+    /**
+     * @brief Set threads used to process frames. Result does not depend on number of threads.
+     * @param pool Thread pool that must outlive audio processor or nullptr to process frames serially.
+     */
+    void setThreadPool(ThreadPool * pool){threadPool = pool;}
 
     /**
      * @brief Convert given audio/pcm buffer into using either MSFB or MFCC matrix.
      * @param buffer Buffer to process.
-     * @param mfcc Set to true if compute MFCC.
+     * @param stats Receives time and memory spent by every stage if not null.
+     * @return Spectogram.
+     */
+    vec2d processBuffer(const byteVec & buffer, Stats * stats = nullptr) const;
+
+    /**
+     * @brief Convert given audio/pcm buffer into using either MSFB or MFCC matrix. Buffer is read in place without any copies.
+     * @param data Buffer to process.
+     * @param size Number of bytes in buffer.
+     * @param stats Receives time and memory spent by every stage if not null.
      * @return Spectogram.
      */
-    MatrixMath::vec2d processBuffer(const byteVec & buffer) const;
+    vec2d processBuffer(const unsigned char * data, std::size_t size, Stats * stats = nullptr) const;
+
+    /**
+     * @brief Convert given audio/pcm buffer into using either MSFB or MFCC matrix. Every stage works in buffers of workspace,
+     * so repeated calls with buffers of the same size make no heap allocations after the first one.
+     * @param buffer Buffer to process.
+     * @param workspace Buffers kept between calls.
+     * @param stats Receives time and memory spent by every stage if not null.
+     * @return Spectogram stored in workspace, valid until workspace is used again.
+     */
+    const vec2d & processBuffer(const byteVec & buffer, Workspace & workspace, Stats * stats = nullptr) const;
+
+    /**
+     * @brief Convert given audio/pcm buffer into using either MSFB or MFCC matrix. Every stage works in buffers of workspace,
+     * so repeated calls with buffers of the same size make no heap allocations after the first one.
+     * @param data Buffer to process.
+     * @param size Number of bytes in buffer.
+     * @param workspace Buffers kept between calls.
+     * @param stats Receives time and memory spent by every stage if not null.
+     * @return Spectogram stored in workspace, valid until workspace is used again.
+     */
+    const vec2d & processBuffer(const unsigned char * data, std::size_t size, Workspace & workspace, Stats * stats = nullptr) const;
+
+    /**
+     * @brief Process next part of audio/pcm stream. Every frame is computed as soon as all of it's samples arrive.
+     * @param data Bytes of audio/pcm stream, may end in the middle of a sample.
+     * @param size Number of bytes.
+     */
+    void pushBytes(const unsigned char * data, std::size_t size);
+
+    /**
+     * @brief Get frames computed since last call. These are features of every frame before normalization,
+     * transposition and rescaling so each row contains single frame.
+     * @param frames Matrix that receives computed frames.
+     * @return Number of frames.
+     */
+    std::size_t popFrames(vec2d & frames);
+
+    /**
+     * @brief Finish processing of stream and reset it so next pushBytes starts a new one.
+     * @param stats Receives time and memory spent by every stage of whole stream if not null.
+     * Total time is sum of time spent in pushBytes and finish.
+     * @return Spectogram of whole stream, same as processBuffer returns for all pushed bytes.
+     */
+    vec2d finish(Stats * stats = nullptr);
+
+    /**
+     * @brief Drop every pushed byte and start a new stream.
+     */
+    void resetStream();
+
+    /**
+     * @brief Preallocate memory for features of stream of known length, so pushBytes doesn't allocate them while stream grows.
+     * Must be called after setConfig or resetStream and before first pushBytes.
+     * @param numBytes Expected number of bytes of whole stream.
+     */
+    void reserveStream(std::size_t numBytes);
+
+    /**
+     * @brief Split audio/pcm buffer into frames, first stage of processBuffer. Together with applyWindow, filterBanks
+     * and MatrixMath functions with FFT and DCT plans of getPlan() it lets every stage be run and timed on it's own.
+     * @param data Buffer to process.
+     * @param size Number of bytes in buffer.
+     * @param frames Matrix that receives single frame in each row, resized to number of frames.
+     */
+    void frameBuffer(const unsigned char * data, std::size_t size, vec2d & frames) const;
+
+    /**
+     * @brief Apply window function of current config to given matrix of frames. Config must be valid.
+     * @param frames Frames to apply window into and also modified frames after function call.
+     */
+    void applyWindow(vec2d & frames) const;
+
+    /**
+     * @brief Apply triangular filters of current config to every row of given matrix. Config must be valid.
+     * @param power Power spectrum of every frame.
+     * @param bands Matrix of power.rows() rows and one column per filter that receives result of operation.
+     */
+    void filterBanks(const vec2d & power, vec2d & bands) const;
 };
 
+extern template class MatrixMath<float>;
+extern template class MatrixMath<double>;
+extern template class MatrixMath<long double>;
+extern template class AudioProcessor<float>;
+extern template class AudioProcessor<double>;
+extern template class AudioProcessor<long double>;
+
 #endif // AUDIOPROCESSOR_H
@@ -0,0 +1,412 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QSettings>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "audioprocessor.h"
+#include "threadpool.h"
+#include "spectogramwriter.h"
+#include "datasetshard.h"
+#include "datasetmanifest.h"
+
+typedef float Scalar; //!< Precision of spectogram computations, same as in GUI.
+typedef AudioProcessor<Scalar> Processor;
+typedef SpectogramWriter<Scalar> Writer;
+typedef ShardWriter<Scalar> Shards;
+
+/**
+ * @brief Single input file and where to save it's spectogram.
+ */
+struct Job{
+    QString input; //!< Path of audio file.
+    QString classDir; //!< Path of class directory in output dataset.
+    qint64 id = 0; //!< Id of clip in manifest of class.
+    Processor::Stats stats; //!< Time and memory spent on spectogram.
+    QString error; //!< Empty if job succeeded.
+};
+
+/**
+ * @brief Read little endian unsigned integer.
+ * @param p First byte of integer.
+ * @param numBytes Size of integer in bytes.
+ * @return Value of integer.
+ */
+static uint32_t readLE(const unsigned char * p, unsigned int numBytes){
+    uint32_t value = 0;
+    for(unsigned int k = 0; k < numBytes; k++){
+        value |= static_cast<uint32_t>(p[k]) << (8 * k);
+    }
+    return value;
+}
+
+/**
+ * @brief Find audio/pcm samples in WAV file and update config with format of file.
+ * @param file Content of WAV file.
+ * @param conf Config to update with sample rate, number of channels and sample size of file.
+ * @param data Receives first byte of samples.
+ * @param size Receives number of bytes of samples.
+ * @return Empty string on success, description of error otherwise.
+ */
+static QString parseWav(const QByteArray & file, Processor::config & conf, const unsigned char *& data, std::size_t & size){
+    const unsigned char * bytes = reinterpret_cast<const unsigned char*>(file.constData());
+    const std::size_t fileSize = static_cast<std::size_t>(file.size());
+
+    if(fileSize < 12 || std::memcmp(bytes, "RIFF", 4) || std::memcmp(bytes + 8, "WAVE", 4))
+        return "Not a RIFF/WAVE file.";
+
+    bool hasFormat = false;
+    std::size_t pos = 12;
+    while(pos + 8 <= fileSize){
+        const unsigned char * chunk = bytes + pos;
+        const std::size_t chunkSize = readLE(chunk + 4, 4);
+        const std::size_t available = std::min(chunkSize, fileSize - pos - 8);
+
+        if(!std::memcmp(chunk, "fmt ", 4)){
+            if(available < 16)
+                return "Invalid fmt chunk.";
+            unsigned int audioFormat = readLE(chunk + 8, 2);
+            if(audioFormat == 0xFFFE && available >= 26) // WAVE_FORMAT_EXTENSIBLE, first two bytes of sub format GUID hold the format
+                audioFormat = readLE(chunk + 32, 2);
+            if(audioFormat != 1)
+                return "Only PCM WAV files are supported.";
+
+            conf.numberOfChannels = readLE(chunk + 10, 2);
+            conf.sampleRate = readLE(chunk + 12, 4);
+            const unsigned int bitsPerSample = readLE(chunk + 22, 2);
+            if(bitsPerSample != 8 && bitsPerSample != 16)
+                return "Only 8 and 16 bit WAV files are supported.";
+            conf.bytesPerSample = bitsPerSample / 8;
+            hasFormat = true;
+        }
+        else if(!std::memcmp(chunk, "data", 4)){
+            if(!hasFormat)
+                return "data chunk before fmt chunk.";
+            const std::size_t groupSize = conf.bytesPerSample * conf.numberOfChannels;
+            data = chunk + 8;
+            size = groupSize ? available - available % groupSize : 0; // drop incomplete sample of truncated file
+            return "";
+        }
+
+        pos += 8 + chunkSize + (chunkSize & 1); // chunks are word aligned
+    }
+
+    return "No data chunk.";
+}
+
+/**
+ * @brief Read config of audio processor from settings file. Missing keys use defaults of GUI.
+ * @param settings Settings file.
+ * @return Config of audio processor.
+ */
+static Processor::config readProcessorConfig(QSettings & settings){
+    Processor::config conf;
+
+    settings.beginGroup("audio");
+    conf.bytesPerSample = settings.value("sampleSize", 8).toUInt() / 8;
+    conf.numberOfChannels = settings.value("channelCount", 1).toUInt();
+    conf.sampleRate = settings.value("sampleRate", 8000).toUInt();
+    settings.endGroup();
+
+    settings.beginGroup("processing");
+    conf.emphasisCoeff = static_cast<Scalar>(settings.value("preEmphasis", 0.97).toDouble());
+    conf.framingSize = settings.value("frameSize", 25).toUInt();
+    conf.framingStride = settings.value("frameStride", 10).toUInt();
+    const QString window = settings.value("window", "hamming").toString().toLower();
+    if(window == "hann")
+        conf.window = WindowFunction::Hann;
+    else if(window == "blackman")
+        conf.window = WindowFunction::Blackman;
+    else if(window == "rectangular")
+        conf.window = WindowFunction::Rectangular;
+    conf.NFFT = settings.value("fftPoints", 512).toUInt();
+    conf.numberOfFilterBanks = settings.value("filterBanks", 26).toUInt();
+    conf.MFCC = settings.value("resultMatrix", "MSFB").toString().toUpper() == "MFCC";
+    conf.firstMFCC = settings.value("firstMFCC", 2).toUInt();
+    conf.lastMFCC = settings.value("lastMFCC", 13).toUInt();
+    conf.sinLift = settings.value("sinLift", false).toBool();
+    conf.cepLifter = settings.value("cepLifter", 22).toUInt();
+    conf.normalize = settings.value("normalize", false).toBool();
+    conf.rescale = settings.value("rescale", false).toBool();
+    conf.rescaleMin = static_cast<Scalar>(settings.value("rescaleMin", 0).toDouble());
+    conf.rescaleMax = static_cast<Scalar>(settings.value("rescaleMax", 1).toDouble());
+    settings.endGroup();
+
+    return conf;
+}
+
+/**
+ * @brief Read format of saved spectograms from settings file.
+ * @param settings Settings file.
+ * @param format Receives format.
+ * @return True if format is valid.
+ */
+static bool readFileFormat(QSettings & settings, SpectogramFormat & format){
+    const QString name = settings.value("output/format", "text").toString().toLower();
+    if(name == "text")
+        format = SpectogramFormat::PlainText;
+    else if(name == "numpy")
+        format = SpectogramFormat::Numpy;
+    else if(name == "color")
+        format = SpectogramFormat::ColorImage;
+    else if(name == "grayscale")
+        format = SpectogramFormat::GrayscaleImage;
+    else if(name == "shard")
+        format = SpectogramFormat::Shard;
+    else
+        return false;
+    return true;
+}
+
+/**
+ * @brief Read format specific options of saved spectograms from settings file.
+ * @param settings Settings file.
+ * @return Options, missing keys use defaults.
+ */
+static SaveOptions readSaveOptions(QSettings & settings){
+    SaveOptions options;
+
+    settings.beginGroup("output");
+    if(settings.value("numpyType", "float32").toString().toLower() == "float64")
+        options.numpyType = NumpyType::Float64;
+    options.textPrecision = settings.value("textPrecision", -1).toInt();
+    // INI trims whitespace, splits lists on commas and starts comments with semicolons, so these are given by name
+    const QString delimiter = settings.value("textDelimiter", "space").toString();
+    if(delimiter == "tab")
+        options.textDelimiter = '\t';
+    else if(delimiter == "comma")
+        options.textDelimiter = ',';
+    else if(delimiter == "semicolon")
+        options.textDelimiter = ';';
+    else if(delimiter.size() == 1)
+        options.textDelimiter = delimiter.at(0).toLatin1();
+    else
+        options.textDelimiter = ' ';
+    settings.endGroup();
+
+    return options;
+}
+
+/**
+ * @brief Collect audio files and give each of them a free id in it's class directory.
+ * Class of file is it's directory relative to input root, files directly in root use defaultClass.
+ * @param inputRoot Root of directory tree with audio files.
+ * @param outputRoot Root of output dataset.
+ * @param defaultClass Class of files placed directly in input root.
+ * @param manifest Gives ids of output files.
+ * @return Jobs sorted by input path.
+ */
+static std::vector<Job> collectJobs(const QString & inputRoot, const QString & outputRoot, const QString & defaultClass, DatasetManifest & manifest){
+    QStringList files;
+    QDirIterator it(inputRoot, {"*.wav", "*.raw", "*.pcm"}, QDir::Files, QDirIterator::Subdirectories);
+    while(it.hasNext()){
+        files.append(it.next());
+    }
+    files.sort();
+
+    const QDir input(inputRoot);
+    std::vector<Job> jobs; // ids are given before any file is written so they follow order of inputs
+    for(const QString & path : files){
+        QString className = input.relativeFilePath(QFileInfo(path).path());
+        if(className.isEmpty() || className == ".")
+            className = defaultClass;
+
+        if(!Writer::prepareClassFolder(outputRoot, className)){
+            std::cerr << "Couldn't create class folder " << className.toStdString() << std::endl;
+            continue;
+        }
+
+        QDir classDir(outputRoot);
+        classDir.cd(className);
+
+        Job job;
+        job.input = path;
+        job.classDir = classDir.path();
+        if(!manifest.reserveId(job.classDir, job.id)){
+            std::cerr << "Couldn't open manifest of class " << className.toStdString() << std::endl;
+            continue;
+        }
+        jobs.push_back(job);
+    }
+    return jobs;
+}
+
+/**
+ * @brief Compute spectogram of single audio file and save it.
+ * @param job File to process, it's error is set on failure.
+ * @param conf Config of audio processor, audio format is replaced by format of WAV files.
+ * @param format Format of saved spectograms.
+ * @param options Format specific options.
+ * @param shards Receives spectograms if format is SpectogramFormat::Shard.
+ * @param manifest Receives every saved spectogram.
+ */
+static void processJob(Job & job, Processor::config conf, SpectogramFormat format, const SaveOptions & options,
+                       Shards & shards, DatasetManifest & manifest){
+    QFile file(job.input);
+    if(!file.open(QIODevice::ReadOnly)){
+        job.error = "Couldn't open file.";
+        return;
+    }
+    const QByteArray content = file.readAll();
+    file.close();
+
+    const unsigned char * data = reinterpret_cast<const unsigned char*>(content.constData());
+    std::size_t size = static_cast<std::size_t>(content.size());
+    if(job.input.endsWith(".wav", Qt::CaseInsensitive)){
+        job.error = parseWav(content, conf, data, size);
+        if(!job.error.isEmpty())
+            return;
+    }
+    else{
+        // raw pcm files have format given in config, drop incomplete sample at the end
+        const std::size_t groupSize = conf.bytesPerSample * conf.numberOfChannels;
+        if(groupSize)
+            size -= size % groupSize;
+    }
+
+    try{
+        // plans are cached by config so files of the same format share them
+        // and every worker thread reuses buffers of previous files
+        Processor processor(conf);
+        thread_local Processor::Workspace workspace;
+        const Processor::vec2d & spectogram = processor.processBuffer(data, size, workspace, &job.stats);
+
+        DatasetManifest::Entry entry;
+        entry.id = job.id;
+        entry.rows = spectogram.rows();
+        entry.cols = spectogram.cols();
+        entry.configHash = conf.hash();
+
+        if(format == SpectogramFormat::Shard){
+            uint32_t shardNumber, clipIndex;
+            if(!shards.append(job.classDir, spectogram, shardNumber, clipIndex)){
+                job.error = "Couldn't append spectogram to shard.";
+                return;
+            }
+            entry.file = DatasetShard::fileName(shardNumber);
+            entry.shard = shardNumber;
+            entry.clip = clipIndex;
+        }
+        else{
+            entry.file = QString::number(job.id) + Writer::extension(format);
+            if(!Writer::save(format, entry.file, job.classDir, spectogram, QImage(), options)){
+                job.error = "Couldn't save file.";
+                return;
+            }
+        }
+
+        if(!manifest.append(job.classDir, entry))
+            job.error = "Couldn't update manifest.";
+    }
+    catch(const AudioProcessorException & e){
+        job.error = e.what();
+    }
+}
+
+/**
+ * @brief Format processing stats of converted file as single JSON line.
+ * @param job Converted file.
+ * @return JSON object without trailing newline.
+ */
+static QByteArray statsJson(const Job & job){
+    const Processor::Stats & s = job.stats;
+    QJsonObject line;
+    line.insert("input", job.input);
+    line.insert("frames", static_cast<qint64>(s.numFrames));
+    line.insert("features", static_cast<qint64>(s.numFeatures));
+    line.insert("audioSeconds", s.audioSeconds);
+    line.insert("framingSeconds", s.framingSeconds);
+    line.insert("featuresSeconds", s.featuresSeconds);
+    line.insert("finishSeconds", s.finishSeconds);
+    line.insert("totalSeconds", s.totalSeconds);
+    line.insert("realTimeFactor", s.realTimeFactor());
+    line.insert("allocatedBytes", static_cast<qint64>(s.allocatedBytes));
+    line.insert("peakMatrixBytes", static_cast<qint64>(s.peakMatrixBytes));
+    return QJsonDocument(line).toJson(QJsonDocument::Compact);
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("spectogram_batch");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Convert directory tree of WAV/raw PCM files into spectogram dataset laid out as \"root/class/N\".");
+    parser.addHelpOption();
+    parser.addPositionalArgument("input", "Directory with audio files, subdirectories are classes.");
+    parser.addPositionalArgument("output", "Root directory of dataset.");
+    parser.addPositionalArgument("config", "Config file in INI format.");
+    QCommandLineOption threadsOption({"j", "threads"}, "Number of threads, all hardware threads by default.", "threads", "0");
+    parser.addOption(threadsOption);
+    QCommandLineOption statsOption("stats", "Print time and memory spent on every converted file as JSON lines.");
+    parser.addOption(statsOption);
+    parser.process(app);
+
+    const QStringList args = parser.positionalArguments();
+    if(args.size() != 3){
+        parser.showHelp(1);
+    }
+
+    if(!QFileInfo(args[2]).isFile()){
+        std::cerr << "Config file " << args[2].toStdString() << " doesn't exist." << std::endl;
+        return 1;
+    }
+    QSettings settings(args[2], QSettings::IniFormat);
+
+    const Processor::config conf = readProcessorConfig(settings);
+    SpectogramFormat format;
+    if(!readFileFormat(settings, format)){
+        std::cerr << "Invalid output format, expected text, numpy, color, grayscale or shard." << std::endl;
+        return 1;
+    }
+    const QString defaultClass = settings.value("output/class", "default").toString();
+    const SaveOptions options = readSaveOptions(settings);
+    bool capacityOk;
+    const uint32_t shardCapacity = settings.value("output/shardCapacity", 65536).toUInt(&capacityOk);
+    if(!capacityOk || shardCapacity == 0 || shardCapacity > DatasetShard::maxCapacity){
+        std::cerr << "Invalid shard capacity, expected number between 1 and " << DatasetShard::maxCapacity << "." << std::endl;
+        return 1;
+    }
+    Shards shards(settings.value("output/shardSize", 256).toULongLong() << 20, shardCapacity);
+
+    if(!QDir().mkpath(args[1])){
+        std::cerr << "Couldn't create output directory." << std::endl;
+        return 1;
+    }
+
+    DatasetManifest manifest;
+    std::vector<Job> jobs = collectJobs(args[0], args[1], defaultClass, manifest);
+
+    // every file is processed on single thread, files are spread across threads
+    ThreadPool pool(parser.value(threadsOption).toUInt());
+    pool.parallelFor(jobs.size(), 1, [&](std::size_t begin, std::size_t end){
+        for(std::size_t i = begin; i < end; i++){
+            processJob(jobs[i], conf, format, options, shards, manifest);
+        }
+    });
+
+    const bool printStats = parser.isSet(statsOption);
+    int numFailed = 0;
+    for(const Job & job : jobs){
+        if(job.error.isEmpty()){
+            if(printStats)
+                std::cout << statsJson(job).toStdString() << '\n';
+            continue;
+        }
+        std::cerr << job.input.toStdString() << ": " << job.error.toStdString() << std::endl;
+        numFailed++;
+    }
+    // stdout holds only JSON lines when stats are printed
+    (printStats ? std::cerr : std::cout) << jobs.size() - numFailed << " of " << jobs.size() << " files converted." << std::endl;
+
+    return numFailed ? 1 : 0;
+}
@@ -0,0 +1,39 @@
+#-------------------------------------------------
+#
+# Headless tool that converts directories of audio files into spectogram dataset
+#
+#-------------------------------------------------
+
+QT       += core gui
+QT       -= widgets
+
+TARGET = spectogram_batch
+TEMPLATE = app
+CONFIG += console c++17
+CONFIG -= app_bundle
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+INCLUDEPATH += $$PWD/..
+
+SOURCES += \
+        main.cpp \
+        ../audioprocessor.cpp \
+        ../datasetmanifest.cpp \
+        ../datasetshard.cpp \
+        ../spectogramwriter.cpp \
+        ../threadpool.cpp
+
+HEADERS += \
+        ../audioprocessor.h \
+        ../datasetmanifest.h \
+        ../datasetshard.h \
+        ../matrix.h \
+        ../simdkernels.h \
+        ../spectogramwriter.h \
+        ../threadpool.h
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
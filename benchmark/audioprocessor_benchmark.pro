@@ -0,0 +1,29 @@
+#-------------------------------------------------
+#
+# Benchmark of every stage of AudioProcessor on synthetic audio, doesn't need Qt or audio device
+#
+#-------------------------------------------------
+
+TARGET = audioprocessor_benchmark
+TEMPLATE = app
+CONFIG += console c++17 release
+CONFIG -= app_bundle qt
+
+INCLUDEPATH += $$PWD/..
+
+# Uncomment to benchmark AVX2 kernels
+#QMAKE_CXXFLAGS += -mavx2       # GCC, Clang
+#QMAKE_CXXFLAGS += /arch:AVX2   # MSVC
+
+unix: LIBS += -lpthread
+
+SOURCES += \
+        main.cpp \
+        ../audioprocessor.cpp \
+        ../threadpool.cpp
+
+HEADERS += \
+        ../audioprocessor.h \
+        ../matrix.h \
+        ../simdkernels.h \
+        ../threadpool.h
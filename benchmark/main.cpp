@@ -0,0 +1,322 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "audioprocessor.h"
+#include "threadpool.h"
+
+/**
+ * Every allocation of the process is counted, so each stage reports how many
+ * allocations and bytes it needed.
+ */
+static std::atomic<unsigned long long> numAllocations(0);
+static std::atomic<unsigned long long> numAllocatedBytes(0);
+
+static void * countedAlloc(std::size_t size, std::size_t alignment){
+    numAllocations++;
+    numAllocatedBytes += size;
+    void * p = nullptr;
+    if(alignment <= alignof(std::max_align_t))
+        p = std::malloc(size ? size : 1);
+    else
+#ifdef _MSC_VER
+        p = _aligned_malloc(size ? size : 1, alignment);
+#else
+        p = std::aligned_alloc(alignment, (std::max<std::size_t>(size, 1) + alignment - 1) / alignment * alignment);
+#endif
+    if(!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+static void countedFree(void * p, std::size_t alignment){
+#ifdef _MSC_VER
+    if(alignment > alignof(std::max_align_t)){
+        _aligned_free(p);
+        return;
+    }
+#else
+    (void)alignment;
+#endif
+    std::free(p);
+}
+
+void * operator new(std::size_t size){return countedAlloc(size, 0);}
+void * operator new[](std::size_t size){return countedAlloc(size, 0);}
+void * operator new(std::size_t size, std::align_val_t al){return countedAlloc(size, static_cast<std::size_t>(al));}
+void * operator new[](std::size_t size, std::align_val_t al){return countedAlloc(size, static_cast<std::size_t>(al));}
+void operator delete(void * p) noexcept {countedFree(p, 0);}
+void operator delete[](void * p) noexcept {countedFree(p, 0);}
+void operator delete(void * p, std::size_t) noexcept {countedFree(p, 0);}
+void operator delete[](void * p, std::size_t) noexcept {countedFree(p, 0);}
+void operator delete(void * p, std::align_val_t al) noexcept {countedFree(p, static_cast<std::size_t>(al));}
+void operator delete[](void * p, std::align_val_t al) noexcept {countedFree(p, static_cast<std::size_t>(al));}
+void operator delete(void * p, std::size_t, std::align_val_t al) noexcept {countedFree(p, static_cast<std::size_t>(al));}
+void operator delete[](void * p, std::size_t, std::align_val_t al) noexcept {countedFree(p, static_cast<std::size_t>(al));}
+
+/**
+ * @brief Parameters of benchmark run, given on command line.
+ */
+struct Options{
+    std::string scalar = "float"; //!< float, double or long-double.
+    std::string signal = "sweep"; //!< sweep or noise.
+    unsigned int duration = 10000; //!< Length of synthetic audio in ms.
+    unsigned int sampleRate = 16000;
+    unsigned int channels = 1;
+    unsigned int bytesPerSample = 2;
+    unsigned int repeats = 10; //!< Runs of every stage, median is reported.
+    unsigned int threads = 0; //!< Threads of parallel pipeline, 0 uses all hardware threads.
+    std::string window = "hamming";
+};
+
+/**
+ * @brief Time of single run of a stage.
+ */
+struct Sample{
+    double seconds = 0;
+    unsigned long long allocations = 0;
+    unsigned long long allocatedBytes = 0;
+};
+
+/**
+ * @brief Times stages of AudioProcessor one by one on synthetic audio through it's public stage functions.
+ */
+class AudioProcessorBenchmark{
+public:
+    /**
+     * @brief Generate synthetic audio/pcm bytes.
+     * @param o Format, length and kind of signal.
+     * @return Bytes of interleaved little endian samples, unsigned for 8 bit and signed for 16 bit samples.
+     */
+    static std::vector<unsigned char> synthesize(const Options & o){
+        const std::size_t numSamples = static_cast<std::size_t>(o.sampleRate) * o.duration / 1000;
+        std::vector<unsigned char> bytes(numSamples * o.channels * o.bytesPerSample);
+
+        std::mt19937 generator(1234); // fixed seed so runs are comparable
+        std::uniform_real_distribution<double> noise(-1, 1);
+        const double pi = 3.14159265358979323846;
+        const double f0 = 50, f1 = 0.45 * o.sampleRate; // exponential sweep almost up to Nyquist
+        const double length = std::max(1.0, static_cast<double>(numSamples)) / o.sampleRate;
+        const double k = std::log(f1 / f0);
+
+        unsigned char * out = bytes.data();
+        for(std::size_t n = 0; n < numSamples; n++){
+            const double t = static_cast<double>(n) / o.sampleRate;
+            for(unsigned int c = 0; c < o.channels; c++){
+                const double value = o.signal == "noise" ? noise(generator) :
+                                     0.8 * std::sin(2 * pi * f0 * length / k * (std::exp(t / length * k) - 1) + c);
+                if(o.bytesPerSample == 1){
+                    *out++ = static_cast<unsigned char>(std::lround(127.5 + 127 * value));
+                }
+                else{
+                    const int16_t s = static_cast<int16_t>(std::lround(32767 * value));
+                    *out++ = static_cast<unsigned char>(s & 0xFF);
+                    *out++ = static_cast<unsigned char>((s >> 8) & 0xFF);
+                }
+            }
+        }
+        return bytes;
+    }
+
+    /**
+     * @brief Run every stage and print one JSON line per stage.
+     * @param o Benchmark parameters.
+     */
+    template<typename T>
+    static void run(const Options & o){
+        typedef AudioProcessor<T> Processor;
+        typedef typename Processor::vec2d vec2d;
+        typedef MatrixMath<T> Math;
+
+        typename Processor::config conf;
+        conf.bytesPerSample = o.bytesPerSample;
+        conf.numberOfChannels = o.channels;
+        conf.sampleRate = o.sampleRate;
+        conf.emphasisCoeff = static_cast<T>(0.97);
+        conf.framingSize = 25;
+        conf.framingStride = 10;
+        conf.window = o.window == "hann" ? WindowFunction::Hann : o.window == "blackman" ? WindowFunction::Blackman :
+                      o.window == "rectangular" ? WindowFunction::Rectangular : WindowFunction::Hamming;
+        conf.NFFT = 512;
+        conf.numberOfFilterBanks = 26;
+        conf.MFCC = true; // dct stage needs plan of MFCC
+        conf.firstMFCC = 2;
+        conf.lastMFCC = 13;
+        conf.sinLift = true;
+        conf.cepLifter = 22;
+        conf.normalize = true;
+        conf.rescale = true;
+        conf.rescaleMin = 0;
+        conf.rescaleMax = 1;
+
+        Processor processor(conf);
+        if(!processor.getPlan()){
+            std::fprintf(stderr, "Invalid audio configuration.\n");
+            std::exit(1);
+        }
+        const std::vector<unsigned char> pcm = synthesize(o);
+        const std::shared_ptr<const typename Processor::Plan> plan = processor.getPlan();
+
+        // input of every stage is output of previous one, computed once outside of timing
+        vec2d frames;
+        processor.frameBuffer(pcm.data(), pcm.size(), frames);
+        vec2d windowed = frames;
+        processor.applyWindow(windowed);
+        vec2d power = windowed;
+        Math::fftMatrix(power, plan->fft);
+        vec2d bands(power.rows(), plan->melFilters.size());
+        processor.filterBanks(power, bands);
+        vec2d coeffs = bands;
+        Math::dctMatrix(coeffs, plan->dct);
+
+        const std::size_t numFrames = frames.rows();
+        std::printf("{\"type\":\"run\",\"scalar\":\"%s\",\"signal\":\"%s\",\"durationMs\":%u,\"sampleRate\":%u,"
+                    "\"channels\":%u,\"bytesPerSample\":%u,\"window\":\"%s\",\"repeats\":%u,\"frames\":%zu,\"pcmBytes\":%zu}\n",
+                    o.scalar.c_str(), o.signal.c_str(), o.duration, o.sampleRate, o.channels, o.bytesPerSample,
+                    o.window.c_str(), o.repeats, numFrames, pcm.size());
+
+        // throughput of every stage is computed from bytes it reads, PCM for stages that start from audio
+        auto matrixBytes = [](const vec2d & m){return static_cast<double>(m.rows() * m.cols() * sizeof(T));};
+        auto report = [&](const char * stage, double inputBytes, const std::function<void()> & prepare, const std::function<void()> & body){
+            std::vector<Sample> samples;
+            for(unsigned int r = 0; r < o.repeats; r++){
+                prepare();
+                Sample s;
+                const unsigned long long allocations = numAllocations, bytes = numAllocatedBytes;
+                const auto start = std::chrono::steady_clock::now();
+                body();
+                const auto stop = std::chrono::steady_clock::now();
+                s.allocations = numAllocations - allocations;
+                s.allocatedBytes = numAllocatedBytes - bytes;
+                s.seconds = std::chrono::duration<double>(stop - start).count();
+                samples.push_back(s);
+            }
+            std::sort(samples.begin(), samples.end(), [](const Sample & a, const Sample & b){return a.seconds < b.seconds;});
+            const Sample & median = samples[samples.size() / 2];
+            std::printf("{\"type\":\"stage\",\"stage\":\"%s\",\"nsPerFrame\":%.2f,\"mbPerSecond\":%.2f,"
+                        "\"medianMs\":%.4f,\"minMs\":%.4f,\"allocations\":%llu,\"allocatedBytes\":%llu}\n",
+                        stage, median.seconds * 1e9 / numFrames, inputBytes / median.seconds / 1e6,
+                        median.seconds * 1e3, samples.front().seconds * 1e3, median.allocations, median.allocatedBytes);
+            std::fflush(stdout);
+        };
+
+        vec2d work;
+        auto none = [](){};
+        // decoding, conversion to mono, pre emphasis and framing are fused into single pass
+        report("frameBytes", static_cast<double>(pcm.size()), [&](){work = vec2d();}, [&](){processor.frameBuffer(pcm.data(), pcm.size(), work);});
+        report("window", matrixBytes(frames), [&](){work = frames;}, [&](){processor.applyWindow(work);});
+        report("fft", matrixBytes(windowed), [&](){work = windowed;}, [&](){Math::fftMatrix(work, plan->fft);});
+        report("filterBanks", matrixBytes(power), [&](){work = vec2d();}, [&](){
+            work = vec2d(power.rows(), plan->melFilters.size());
+            processor.filterBanks(power, work);
+        });
+        report("dct", matrixBytes(bands), [&](){work = bands;}, [&](){Math::dctMatrix(work, plan->dct);});
+        report("normalize", matrixBytes(coeffs), [&](){work = coeffs;}, [&](){Math::normalizeMatrixByColumns(work);});
+        report("transpose", matrixBytes(coeffs), [&](){work = coeffs;}, [&](){Math::transposeMatrix(work);});
+        report("rescale", matrixBytes(coeffs), [&](){work = coeffs;}, [&](){Math::rescaleMatrix(work, conf.rescaleMin, conf.rescaleMax);});
+
+        report("pipeline", static_cast<double>(pcm.size()), none, [&](){work = processor.processBuffer(pcm.data(), pcm.size());});
+
+        // buffers are warmed up by first run, so only the first one allocates
+        typename Processor::Workspace workspace;
+        report("pipelineWorkspace", static_cast<double>(pcm.size()), none, [&](){processor.processBuffer(pcm.data(), pcm.size(), workspace);});
+
+        ThreadPool pool(o.threads);
+        Processor parallel(conf);
+        parallel.setThreadPool(&pool);
+        report("pipelineParallel", static_cast<double>(pcm.size()), none, [&](){work = parallel.processBuffer(pcm.data(), pcm.size());});
+
+        typename Processor::Workspace parallelWorkspace;
+        report("pipelineParallelWorkspace", static_cast<double>(pcm.size()), none, [&](){parallel.processBuffer(pcm.data(), pcm.size(), parallelWorkspace);});
+
+        // chunks of 20 ms like QAudioInput delivers them
+        const std::size_t chunk = std::max<std::size_t>(1, pcm.size() / std::max(1u, o.duration / 20));
+        Processor stream(conf);
+        report("stream", static_cast<double>(pcm.size()), [&](){stream.resetStream();}, [&](){
+            for(std::size_t pos = 0; pos < pcm.size(); pos += chunk){
+                stream.pushBytes(pcm.data() + pos, std::min(chunk, pcm.size() - pos));
+            }
+            work = stream.finish();
+        });
+    }
+};
+
+static void usage(){
+    std::fprintf(stderr,
+                 "Usage: audioprocessor_benchmark [options]\n"
+                 "  --scalar float|double|long-double   precision of computations (float)\n"
+                 "  --signal sweep|noise                synthetic input (sweep)\n"
+                 "  --duration ms                       length of input (10000)\n"
+                 "  --rate hz                           sample rate (16000)\n"
+                 "  --channels n                        channel count (1)\n"
+                 "  --bytes 1|2                         bytes per sample (2)\n"
+                 "  --window hamming|hann|blackman|rectangular\n"
+                 "  --repeats n                         runs of every stage, median is reported (10)\n"
+                 "  --threads n                         threads of parallel pipeline, 0 for all (0)\n"
+                 "Prints one JSON object per line: parameters of run, then every stage.\n");
+}
+
+int main(int argc, char *argv[])
+{
+    Options o;
+    for(int i = 1; i < argc; i++){
+        const std::string arg = argv[i];
+        if(i + 1 >= argc || arg.compare(0, 2, "--")){
+            usage();
+            return 1;
+        }
+        const std::string value = argv[++i];
+        const unsigned int number = static_cast<unsigned int>(std::strtoul(value.c_str(), nullptr, 10));
+        if(arg == "--scalar")
+            o.scalar = value;
+        else if(arg == "--signal")
+            o.signal = value;
+        else if(arg == "--duration")
+            o.duration = number;
+        else if(arg == "--rate")
+            o.sampleRate = number;
+        else if(arg == "--channels")
+            o.channels = number;
+        else if(arg == "--bytes")
+            o.bytesPerSample = number;
+        else if(arg == "--window")
+            o.window = value;
+        else if(arg == "--repeats")
+            o.repeats = std::max(1u, number);
+        else if(arg == "--threads")
+            o.threads = number;
+        else{
+            usage();
+            return 1;
+        }
+    }
+    if((o.bytesPerSample != 1 && o.bytesPerSample != 2) || !o.channels || !o.sampleRate){
+        usage();
+        return 1;
+    }
+
+    try{
+        if(o.scalar == "double")
+            AudioProcessorBenchmark::run<double>(o);
+        else if(o.scalar == "long-double")
+            AudioProcessorBenchmark::run<long double>(o);
+        else
+            AudioProcessorBenchmark::run<float>(o);
+    }
+    catch(const AudioProcessorException & e){
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
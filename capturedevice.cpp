@@ -0,0 +1,48 @@
+#include "capturedevice.h"
+
+#include <algorithm>
+
+CaptureDevice::CaptureDevice(QObject *parent) : QIODevice(parent)
+{
+}
+
+bool CaptureDevice::startCapture(qint64 segmentSize, unsigned long numSegments){
+    if(isOpen())
+        close();
+
+    this->segmentSize = segmentSize;
+    this->numSegments = numSegments;
+    segmentBytes = 0;
+    finishedSegments = 0;
+
+    return open(QIODevice::WriteOnly);
+}
+
+qint64 CaptureDevice::readData(char *data, qint64 maxSize){
+    Q_UNUSED(data);
+    Q_UNUSED(maxSize);
+    return -1;
+}
+
+qint64 CaptureDevice::writeData(const char *data, qint64 size){
+    qint64 pos = 0;
+    while(pos < size && !isFinished()){
+        // never let single part cross segment boundary
+        qint64 part = size - pos;
+        if(segmentSize > 0)
+            part = std::min(part, segmentSize - segmentBytes);
+
+        emit captured(data + pos, part);
+        pos += part;
+        segmentBytes += part;
+
+        if(segmentSize > 0 && segmentBytes == segmentSize){
+            segmentBytes = 0;
+            finishedSegments++;
+            emit segmentFinished();
+        }
+    }
+
+    // bytes after last segment are accepted and dropped so writer doesn't report errors
+    return size;
+}
@@ -0,0 +1,61 @@
+#ifndef CAPTUREDEVICE_H
+#define CAPTUREDEVICE_H
+
+#include <QIODevice>
+
+/**
+ * @brief Write only device that receives audio/pcm bytes from QAudioInput and splits them into segments
+ * of exact number of bytes as they are written, without polling and without storing them.
+ *
+ * Signals are emitted from inside of write() so receivers should be connected directly and must not
+ * stop the audio input that writes into the device from their slots.
+ */
+class CaptureDevice : public QIODevice
+{
+    Q_OBJECT
+
+public:
+    explicit CaptureDevice(QObject *parent = nullptr);
+
+    /**
+     * @brief Open device for writing and start new capture.
+     * @param segmentSize Number of bytes of single segment, 0 captures single segment until device is closed.
+     * @param numSegments Number of segments to capture, 0 captures segments until device is closed.
+     * Bytes written after last segment are discarded.
+     * @return True if device was opened.
+     */
+    bool startCapture(qint64 segmentSize, unsigned long numSegments);
+
+    /**
+     * @brief Check whether every requested segment was captured.
+     * @return True if last segment is finished.
+     */
+    bool isFinished() const {return segmentSize > 0 && numSegments > 0 && finishedSegments >= numSegments;}
+
+    bool isSequential() const override {return true;}
+
+signals:
+    /**
+     * @brief Emitted for every part of written bytes, part never crosses segment boundary.
+     * @param data Captured bytes, valid only until slot returns.
+     * @param size Number of bytes.
+     */
+    void captured(const char *data, qint64 size);
+
+    /**
+     * @brief Emitted right after last byte of segment was passed to captured().
+     */
+    void segmentFinished();
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 size) override;
+
+private:
+    qint64 segmentSize = 0; //!< Number of bytes of single segment, 0 if capture isn't split.
+    unsigned long numSegments = 0; //!< Number of segments to capture, 0 if unlimited.
+    qint64 segmentBytes = 0; //!< Number of bytes of current segment captured so far.
+    unsigned long finishedSegments = 0; //!< Number of segments captured so far.
+};
+
+#endif // CAPTUREDEVICE_H
@@ -22,28 +22,39 @@ DEFINES += QT_DEPRECATED_WARNINGS
 # You can also select to disable deprecated APIs only up to a certain version of Qt.
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
-CONFIG += c++11
+CONFIG += c++17
+
+# Vectorized kernels use SSE2/NEON by default, uncomment following lines to enable AVX2 kernels
+# (resulting binary won't run on CPUs without AVX2).
+#QMAKE_CXXFLAGS += -mavx2       # GCC, Clang
+#QMAKE_CXXFLAGS += /arch:AVX2   # MSVC
 
 SOURCES += \
         audioprocessor.cpp \
+        capturedevice.cpp \
+        datasetmanifest.cpp \
+        datasetshard.cpp \
         main.cpp \
         mainwindow.cpp \
-        thirdparty/cnpy/cnpy.cpp
+        recordingsaver.cpp \
+        spectogramwriter.cpp \
+        threadpool.cpp
 
 HEADERS += \
         audioprocessor.h \
+        capturedevice.h \
+        datasetmanifest.h \
+        datasetshard.h \
         mainwindow.h \
-        thirdparty/cnpy/cnpy.h
+        matrix.h \
+        recordingsaver.h \
+        simdkernels.h \
+        spectogramwriter.h \
+        threadpool.h
 
 FORMS += \
         mainwindow.ui
 
-INCLUDEPATH += $$PWD/../../../Programy/Programowanie/zlib/include
-
-LIBS += -L$$PWD/../../../Programy/Programowanie/zlib/lib \
-        -L$$PWD/../../../Programy/Programowanie/zlib/bin \
-        -llibz
-
 # Default rules for deployment.
 qnx: target.path = /tmp/$${TARGET}/bin
 else: unix:!android: target.path = /opt/$${TARGET}/bin
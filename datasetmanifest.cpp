@@ -0,0 +1,100 @@
+#include "datasetmanifest.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <algorithm>
+
+const char * const DatasetManifest::fileName = "manifest.jsonl";
+
+DatasetManifest::ClassManifest * DatasetManifest::load(const QString & dname){
+    std::unique_ptr<ClassManifest> & manifest = manifests[dname];
+    if(manifest)
+        return manifest.get();
+
+    std::unique_ptr<ClassManifest> loaded(new ClassManifest);
+    const QDir dir(dname);
+    loaded->file.setFileName(dir.filePath(fileName));
+
+    qint64 lastId = 0;
+    if(loaded->file.exists()){
+        if(!loaded->file.open(QIODevice::ReadOnly)){
+            manifests.erase(dname);
+            return nullptr;
+        }
+        while(!loaded->file.atEnd()){
+            const QByteArray bytes = loaded->file.readLine();
+            loaded->tornTail = !bytes.endsWith('\n');
+            const QJsonObject line = QJsonDocument::fromJson(bytes).object();
+            lastId = std::max(lastId, line.value("id").toVariant().toLongLong()); // torn lines give 0
+        }
+        loaded->file.close();
+    }
+    if(lastId == 0){
+        // dataset recorded without manifest or manifest without any clip, numbered files are the only record of used ids
+        const QStringList names = dir.entryList(QDir::Files);
+        for(const QString & name : names){
+            bool ok;
+            const qint64 id = QFileInfo(name).completeBaseName().toLongLong(&ok);
+            if(ok)
+                lastId = std::max(lastId, id);
+        }
+    }
+
+    loaded->nextId = lastId + 1;
+
+    manifest = std::move(loaded);
+    return manifest.get();
+}
+
+bool DatasetManifest::reserveId(const QString & dname, qint64 & id){
+    std::lock_guard<std::mutex> lock(mutex);
+
+    ClassManifest * manifest = load(dname);
+    if(!manifest)
+        return false;
+    id = manifest->nextId++;
+    return true;
+}
+
+bool DatasetManifest::append(const QString & dname, const Entry & entry){
+    QJsonObject line;
+    line.insert("id", entry.id);
+    line.insert("file", entry.file);
+    line.insert("rows", static_cast<qint64>(entry.rows));
+    line.insert("cols", static_cast<qint64>(entry.cols));
+    line.insert("config", QString("%1").arg(entry.configHash, 16, 16, QChar('0'))); // doubles of JSON can't hold 64 bits
+    line.insert("time", QDateTime::currentDateTimeUtc().toString(Qt::ISODateWithMs));
+    if(entry.shard >= 0){
+        line.insert("shard", entry.shard);
+        line.insert("clip", entry.clip);
+    }
+    const QByteArray bytes = QJsonDocument(line).toJson(QJsonDocument::Compact) + '\n';
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    ClassManifest * manifest = load(dname);
+    if(!manifest)
+        return false;
+
+    // file is created by first saved clip, so ids reserved by clips that were never saved leave no empty manifest behind
+    if(!manifest->file.isOpen()){
+        if(!manifest->file.open(QIODevice::WriteOnly | QIODevice::Append))
+            return false;
+        // torn line of interrupted write must not swallow the next one
+        if(manifest->tornTail && manifest->file.write("\n") != 1){
+            manifest->file.close();
+            return false;
+        }
+        manifest->tornTail = false;
+    }
+
+    // whole line in single write, so concurrent readers see either all of it or torn tail that's skipped
+    if(manifest->file.write(bytes) != bytes.size() || !manifest->file.flush())
+        return false;
+    manifest->nextId = std::max(manifest->nextId, entry.id + 1);
+    return true;
+}
@@ -0,0 +1,79 @@
+#ifndef DATASETMANIFEST_H
+#define DATASETMANIFEST_H
+
+#include <QString>
+#include <QFile>
+
+#include <map>
+#include <memory>
+#include <mutex>
+
+/**
+ * @brief Journal of clips saved into class directories, kept as "root/class/manifest.jsonl".
+ *
+ * Every saved clip appends single JSON line with it's id, file, shape, hash of processing config,
+ * UTC timestamp and, for shards, position inside of shard. Lines are never rewritten and line cut
+ * by a crash is skipped on load. Manifest of class is read once, after that new ids cost nothing.
+ * Safe to use from many threads.
+ */
+class DatasetManifest{
+public:
+    /**
+     * @brief Single saved clip.
+     */
+    struct Entry{
+        qint64 id = 0; //!< Id of clip, unique inside of class.
+        QString file; //!< Name of file holding clip, relative to class directory.
+        quint64 rows = 0; //!< Number of features, saved spectogram is transposed so every row is single feature.
+        quint64 cols = 0; //!< Number of frames.
+        quint64 configHash = 0; //!< Hash of config spectogram was computed with.
+        qint64 shard = -1; //!< Number of shard, -1 if clip has file on it's own.
+        qint64 clip = -1; //!< Index of clip inside of shard, -1 if clip has file on it's own.
+    };
+
+    static const char * const fileName; //!< Name of manifest inside of class directory.
+
+    DatasetManifest() = default;
+
+    DatasetManifest(const DatasetManifest &) = delete;
+    DatasetManifest & operator=(const DatasetManifest &) = delete;
+
+    /**
+     * @brief Give next free id of class. Ids are never reused, even if clip that got it is never saved.
+     * @param dname Class directory path, must exist.
+     * @param id Receives id, first clip of class gets 1.
+     * @return False if manifest couldn't be opened.
+     */
+    bool reserveId(const QString & dname, qint64 & id);
+
+    /**
+     * @brief Append saved clip to manifest of class with current time.
+     * @param dname Class directory path, must exist.
+     * @param entry Saved clip.
+     * @return True if whole line was written.
+     */
+    bool append(const QString & dname, const Entry & entry);
+
+private:
+    /**
+     * @brief Manifest of single class directory.
+     */
+    struct ClassManifest{
+        QFile file; //!< Opened for appending by first append.
+        qint64 nextId = 1;
+        bool tornTail = false; //!< True if last line of file isn't terminated.
+    };
+
+    std::mutex mutex; //!< Guards manifests.
+    std::map<QString, std::unique_ptr<ClassManifest>> manifests; //!< Keyed by class directory path.
+
+    /**
+     * @brief Get manifest of class directory, reading it on first use.
+     * Directories whose manifest holds no clip, i.e saved before manifests existed, are scanned once for numbered files instead.
+     * @param dname Class directory path.
+     * @return Manifest or nullptr if it couldn't be opened.
+     */
+    ClassManifest * load(const QString & dname);
+};
+
+#endif // DATASETMANIFEST_H
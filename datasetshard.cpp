@@ -0,0 +1,259 @@
+#include "datasetshard.h"
+
+#include <QDir>
+#include <QByteArray>
+#include <QSysInfo>
+#include <QtEndian>
+
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+namespace{
+    /**
+     * @brief Round offset up to multiple of DatasetShard::alignment.
+     */
+    uint64_t alignUp(uint64_t offset){
+        return (offset + DatasetShard::alignment - 1) / DatasetShard::alignment * DatasetShard::alignment;
+    }
+
+    /**
+     * @brief Convert numbers of header between host and little endian byte order, conversion is the same both ways.
+     */
+    DatasetShard::Header littleEndian(DatasetShard::Header header){
+        header.version = qToLittleEndian(header.version);
+        header.capacity = qToLittleEndian(header.capacity);
+        header.count = qToLittleEndian(header.count);
+        header.reserved = qToLittleEndian(header.reserved);
+        header.payloadOffset = qToLittleEndian(header.payloadOffset);
+        return header;
+    }
+
+    /**
+     * @brief Convert numbers of index entry between host and little endian byte order, conversion is the same both ways.
+     */
+    DatasetShard::IndexEntry littleEndian(DatasetShard::IndexEntry entry){
+        entry.offset = qToLittleEndian(entry.offset);
+        entry.rows = qToLittleEndian(entry.rows);
+        entry.cols = qToLittleEndian(entry.cols);
+        return entry;
+    }
+
+    /**
+     * @brief Check whether header describes shard this code can read.
+     */
+    bool isValidHeader(const DatasetShard::Header & header, uint64_t fileSize){
+        return !std::memcmp(header.magic, DatasetShard::magic, sizeof(header.magic))
+                && header.version == DatasetShard::version
+                && header.count <= header.capacity
+                && header.payloadOffset >= sizeof(DatasetShard::Header) + uint64_t(header.capacity) * sizeof(DatasetShard::IndexEntry)
+                && header.payloadOffset <= fileSize;
+    }
+
+    /**
+     * @brief Check whether clip lies inside of file.
+     */
+    bool isValidEntry(const DatasetShard::IndexEntry & entry, const DatasetShard::Header & header, uint64_t fileSize){
+        const uint64_t bytes = uint64_t(entry.rows) * entry.cols * sizeof(float);
+        return entry.offset >= header.payloadOffset && entry.offset <= fileSize && bytes <= fileSize - entry.offset;
+    }
+}
+
+QString DatasetShard::fileName(uint32_t number){
+    return QString::number(number) + ".shard";
+}
+
+template<typename T>
+ShardWriter<T>::ShardWriter(uint64_t maxShardBytes, uint32_t indexCapacity)
+    : maxShardBytes(maxShardBytes), indexCapacity(std::min(std::max(indexCapacity, 1u), DatasetShard::maxCapacity)){
+}
+
+template<typename T>
+std::unique_ptr<typename ShardWriter<T>::OpenShard> ShardWriter<T>::reopenLast(const QString & dname, uint32_t & lastNumber){
+    lastNumber = 0;
+    const QStringList names = QDir(dname).entryList({"*.shard"}, QDir::Files);
+    for(const QString & name : names){
+        bool ok;
+        const uint32_t number = name.chopped(6).toUInt(&ok);
+        if(ok && number > lastNumber)
+            lastNumber = number;
+    }
+    if(!lastNumber)
+        return nullptr;
+
+    std::unique_ptr<OpenShard> shard(new OpenShard);
+    shard->number = lastNumber;
+    shard->file.setFileName(dname + "/" + DatasetShard::fileName(lastNumber));
+    if(!shard->file.open(QIODevice::ReadWrite))
+        return nullptr;
+
+    const uint64_t fileSize = static_cast<uint64_t>(shard->file.size());
+    DatasetShard::Header & header = shard->header;
+    if(shard->file.read(reinterpret_cast<char*>(&header), sizeof(header)) != sizeof(header))
+        return nullptr;
+    header = littleEndian(header);
+    if(!isValidHeader(header, fileSize) || header.count >= header.capacity)
+        return nullptr;
+
+    // anything behind last committed clip is leftover of interrupted append and gets overwritten
+    shard->end = header.payloadOffset;
+    if(header.count){
+        DatasetShard::IndexEntry last;
+        if(!shard->file.seek(sizeof(header) + (header.count - 1) * sizeof(last))
+                || shard->file.read(reinterpret_cast<char*>(&last), sizeof(last)) != sizeof(last))
+            return nullptr;
+        last = littleEndian(last);
+        if(!isValidEntry(last, header, fileSize))
+            return nullptr;
+        shard->end = last.offset + uint64_t(last.rows) * last.cols * sizeof(float);
+    }
+    return shard;
+}
+
+template<typename T>
+std::unique_ptr<typename ShardWriter<T>::OpenShard> ShardWriter<T>::create(const QString & dname, uint32_t number){
+    std::unique_ptr<OpenShard> shard(new OpenShard);
+    shard->number = number;
+    shard->file.setFileName(dname + "/" + DatasetShard::fileName(number));
+    if(!shard->file.open(QIODevice::ReadWrite | QIODevice::Truncate))
+        return nullptr;
+
+    DatasetShard::Header & header = shard->header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, DatasetShard::magic, sizeof(header.magic));
+    header.version = DatasetShard::version;
+    header.capacity = indexCapacity;
+    header.payloadOffset = alignUp(sizeof(header) + uint64_t(indexCapacity) * sizeof(DatasetShard::IndexEntry));
+    shard->end = header.payloadOffset;
+    if(header.payloadOffset > static_cast<uint64_t>(std::numeric_limits<int>::max()))
+        return nullptr; // header and index wouldn't fit into single QByteArray
+
+    // header and zeroed index in single write
+    QByteArray head(static_cast<int>(header.payloadOffset), '\0');
+    const DatasetShard::Header stored = littleEndian(header);
+    std::memcpy(head.data(), &stored, sizeof(stored));
+    if(shard->file.write(head) != head.size() || !shard->file.flush())
+        return nullptr;
+    return shard;
+}
+
+template<typename T>
+bool ShardWriter<T>::append(const QString & dname, const vec2d & data, uint32_t & shardNumber, uint32_t & clipIndex){
+    // convert to little endian float32 outside of lock so threads of batch tool only wait for the writes
+    std::vector<uint32_t> values(data.rows() * data.cols());
+    for(std::size_t i = 0; i < data.rows(); i++){
+        for(std::size_t j = 0; j < data.cols(); j++){
+            const float value = static_cast<float>(data(i, j));
+            uint32_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            values[i * data.cols() + j] = qToLittleEndian(bits);
+        }
+    }
+    const uint64_t bytes = values.size() * sizeof(float);
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    std::unique_ptr<OpenShard> & shard = shards[dname];
+    if(!shard){
+        uint32_t lastNumber;
+        shard = reopenLast(dname, lastNumber);
+        if(!shard)
+            shard = create(dname, lastNumber + 1);
+        if(!shard){
+            shards.erase(dname);
+            return false;
+        }
+    }
+
+    uint64_t offset = alignUp(shard->end);
+    if(shard->header.count >= shard->header.capacity || (shard->header.count && offset + bytes > maxShardBytes)){
+        std::unique_ptr<OpenShard> next = create(dname, shard->number + 1);
+        if(!next)
+            return false;
+        shard = std::move(next);
+        offset = shard->end;
+    }
+    DatasetShard::Header & header = shard->header;
+
+    // payload, index entry and count are written in this order so shard is never left inconsistent
+    const DatasetShard::IndexEntry entry = littleEndian(DatasetShard::IndexEntry{offset, static_cast<uint32_t>(data.rows()), static_cast<uint32_t>(data.cols())});
+    const uint32_t count = qToLittleEndian(header.count + 1);
+    QFile & file = shard->file;
+    if(!file.seek(static_cast<qint64>(offset))
+            || file.write(reinterpret_cast<const char*>(values.data()), static_cast<qint64>(bytes)) != static_cast<qint64>(bytes)
+            || !file.seek(static_cast<qint64>(sizeof(DatasetShard::Header) + header.count * sizeof(entry)))
+            || file.write(reinterpret_cast<const char*>(&entry), sizeof(entry)) != sizeof(entry)
+            || !file.seek(offsetof(DatasetShard::Header, count))
+            || file.write(reinterpret_cast<const char*>(&count), sizeof(count)) != sizeof(count)
+            || !file.flush())
+        return false;
+
+    shardNumber = shard->number;
+    clipIndex = header.count;
+    header.count++;
+    shard->end = offset + bytes;
+    return true;
+}
+
+template<typename T>
+bool ShardWriter<T>::append(const QString & dname, const vec2d & data){
+    uint32_t shardNumber, clipIndex;
+    return append(dname, data, shardNumber, clipIndex);
+}
+
+ShardReader::~ShardReader(){
+    close();
+}
+
+bool ShardReader::open(const QString & path){
+    close();
+
+    // clips are returned as float pointers into the file
+    if(QSysInfo::ByteOrder != QSysInfo::LittleEndian)
+        return false;
+
+    file.setFileName(path);
+    if(!file.open(QIODevice::ReadOnly) || file.size() < static_cast<qint64>(sizeof(DatasetShard::Header))){
+        close();
+        return false;
+    }
+
+    const uint64_t fileSize = static_cast<uint64_t>(file.size());
+    mapped = file.map(0, file.size());
+    if(!mapped){
+        close();
+        return false;
+    }
+
+    const DatasetShard::Header & header = *reinterpret_cast<const DatasetShard::Header*>(mapped);
+    if(!isValidHeader(header, fileSize)){
+        close();
+        return false;
+    }
+    index = reinterpret_cast<const DatasetShard::IndexEntry*>(mapped + sizeof(DatasetShard::Header));
+    count = header.count;
+
+    // checked once here so lookups don't have to
+    for(uint32_t i = 0; i < count; i++){
+        if(!isValidEntry(index[i], header, fileSize)){
+            close();
+            return false;
+        }
+    }
+    return true;
+}
+
+void ShardReader::close(){
+    if(mapped)
+        file.unmap(const_cast<uchar*>(mapped));
+    mapped = nullptr;
+    index = nullptr;
+    count = 0;
+    file.close();
+}
+
+template class ShardWriter<float>;
+template class ShardWriter<double>;
+template class ShardWriter<long double>;
@@ -0,0 +1,197 @@
+#ifndef DATASETSHARD_H
+#define DATASETSHARD_H
+
+#include <QString>
+#include <QFile>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+
+#include "matrix.h"
+
+/**
+ * @brief Append only container that stores many spectograms of single class in one file.
+ *
+ * Layout of shard, every number is little endian regardless of host:
+ * - header, 64 bytes: magic "SPECSHRD", version, index capacity, number of stored clips, offset of payload,
+ * - index of fixed capacity, 16 bytes per clip: offset of clip's payload, rows, cols,
+ * - payload, row major float32 matrices, every one aligned to 64 bytes.
+ *
+ * Clip is written before it's index entry and number of clips in header is updated last,
+ * so clips cut by a crash are never visible to readers.
+ */
+namespace DatasetShard{
+    constexpr char magic[8] = {'S', 'P', 'E', 'C', 'S', 'H', 'R', 'D'};
+    constexpr uint32_t version = 1;
+    constexpr uint64_t alignment = 64; //!< Alignment of index and of every clip's payload.
+    constexpr uint32_t maxCapacity = 1u << 20; //!< Largest index capacity, header and index of 16 MiB are written at once.
+
+    /**
+     * @brief Header at the beginning of every shard.
+     */
+    struct Header{
+        char magic[8];
+        uint32_t version;
+        uint32_t capacity; //!< Number of entries in index.
+        uint32_t count; //!< Number of stored clips.
+        uint32_t reserved;
+        uint64_t payloadOffset; //!< Offset of first byte after index.
+        uint8_t padding[32];
+    };
+    static_assert(sizeof(Header) == 64, "Shard header must take 64 bytes.");
+
+    /**
+     * @brief Single entry of shard's index.
+     */
+    struct IndexEntry{
+        uint64_t offset; //!< Offset of clip's first value from beginning of file.
+        uint32_t rows;
+        uint32_t cols;
+    };
+    static_assert(sizeof(IndexEntry) == 16, "Shard index entry must take 16 bytes.");
+
+    /**
+     * @brief Get name of shard file with given number, i.e "1.shard".
+     * @param number Number of shard.
+     * @return File name.
+     */
+    QString fileName(uint32_t number);
+}
+
+/**
+ * @brief Appends spectograms to shards "root/class/N.shard", starting new shard once current one
+ * reaches size limit or it's index is full. Last shard of class is reopened and extended after restart.
+ * Safe to use from many threads, appends are serialized.
+ * @tparam T Scalar type of spectogram, i.e float, double or long double. Stored as float32.
+ */
+template<typename T>
+class ShardWriter{
+public:
+    typedef Matrix<T> vec2d;
+
+    /**
+     * @brief Class constructor.
+     * @param maxShardBytes Size after which new shard is started. Clip larger than that gets shard on it's own.
+     * @param indexCapacity Maximum number of clips in single shard, at most DatasetShard::maxCapacity.
+     */
+    explicit ShardWriter(uint64_t maxShardBytes = 256ull << 20, uint32_t indexCapacity = 65536);
+
+    ShardWriter(const ShardWriter &) = delete;
+    ShardWriter & operator=(const ShardWriter &) = delete;
+
+    /**
+     * @brief Append spectogram to current shard of class directory.
+     * @param dname Class directory path, must exist.
+     * @param data Spectogram data.
+     * @param shardNumber Receives number of shard clip was written to.
+     * @param clipIndex Receives index of clip inside of shard.
+     * @return True on success.
+     */
+    bool append(const QString & dname, const vec2d & data, uint32_t & shardNumber, uint32_t & clipIndex);
+
+    /**
+     * @brief Append spectogram to current shard of class directory.
+     * @param dname Class directory path, must exist.
+     * @param data Spectogram data.
+     * @return True on success.
+     */
+    bool append(const QString & dname, const vec2d & data);
+
+private:
+    /**
+     * @brief Shard currently extended in single class directory.
+     */
+    struct OpenShard{
+        QFile file;
+        uint32_t number = 0; //!< Number in shard's file name.
+        DatasetShard::Header header;
+        uint64_t end = 0; //!< End of last committed clip.
+    };
+
+    uint64_t maxShardBytes;
+    uint32_t indexCapacity;
+    std::mutex mutex; //!< Guards shards.
+    std::map<QString, std::unique_ptr<OpenShard>> shards; //!< Keyed by class directory path.
+
+    /**
+     * @brief Reopen last shard of class directory if it can be extended.
+     * @param dname Class directory path.
+     * @param lastNumber Receives number of last shard in directory, 0 if there is none.
+     * @return Opened shard or nullptr if there is none to extend.
+     */
+    std::unique_ptr<OpenShard> reopenLast(const QString & dname, uint32_t & lastNumber);
+
+    /**
+     * @brief Create empty shard with header and zeroed index.
+     * @param dname Class directory path.
+     * @param number Number of new shard.
+     * @return Created shard or nullptr on error.
+     */
+    std::unique_ptr<OpenShard> create(const QString & dname, uint32_t number);
+};
+
+/**
+ * @brief Read only view of shard mapped into memory. Any clip is found in constant time through the index.
+ * Values are used in place without conversion, so shards can be opened on little endian hosts only.
+ */
+class ShardReader{
+public:
+    ShardReader() = default;
+    ~ShardReader();
+
+    ShardReader(const ShardReader &) = delete;
+    ShardReader & operator=(const ShardReader &) = delete;
+
+    /**
+     * @brief Map shard into memory.
+     * @param path Path of shard file.
+     * @return True if file is valid shard and host is little endian.
+     */
+    bool open(const QString & path);
+
+    /**
+     * @brief Unmap shard.
+     */
+    void close();
+
+    /**
+     * @brief Get number of clips in shard when it was opened.
+     * @return Number of clips.
+     */
+    uint32_t size() const {return count;}
+
+    /**
+     * @brief Get number of rows of clip.
+     * @param i Index of clip.
+     * @return Number of rows.
+     */
+    uint32_t rows(uint32_t i) const {return index[i].rows;}
+
+    /**
+     * @brief Get number of columns of clip.
+     * @param i Index of clip.
+     * @return Number of columns.
+     */
+    uint32_t cols(uint32_t i) const {return index[i].cols;}
+
+    /**
+     * @brief Get row major values of clip.
+     * @param i Index of clip.
+     * @return Pointer to rows(i) * cols(i) values inside of mapped file.
+     */
+    const float * data(uint32_t i) const {return reinterpret_cast<const float*>(mapped + index[i].offset);}
+
+private:
+    QFile file;
+    const uchar * mapped = nullptr;
+    const DatasetShard::IndexEntry * index = nullptr;
+    uint32_t count = 0; //!< Clips appended after open aren't visible, their payload might not be mapped.
+};
+
+extern template class ShardWriter<float>;
+extern template class ShardWriter<double>;
+extern template class ShardWriter<long double>;
+
+#endif // DATASETSHARD_H
@@ -3,19 +3,16 @@
 #include <qfiledialog.h>
 #include <qaudiodeviceinfo.h>
 #include <QMessageBox>
-#include <QTextStream>
 #include <QPixmap>
+#include <QStatusBar>
 #include <QTimer>
 
 #include <algorithm>
 #include <complex>
 
-#include "thirdparty/cnpy/cnpy.h"
-
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
     ui(new Ui::MainWindow),
-    recorder(new QTimer(this)),
     counter(new QTimer(this)),
     startSound(":/start.wav"),
     stopSound(":/stop.wav")
@@ -41,18 +38,12 @@ MainWindow::MainWindow(QWidget *parent) :
 
     ui->stopButton->setEnabled(false);
 
-    connect(recorder, &QTimer::timeout, [this](){
-        const int sampleRate = ui->sampleRateInput->text().toInt();
-        const int numChannels = ui->channelCountInput->text().toInt();
-        const int bytesPerSample = ui->sampleSize->currentText().toInt()/8;
-        const int recordDuration = ui->durationInput->text().toInt();
-
-        while(audioBuf.buffer().size() < sampleRate*recordDuration*0.001*bytesPerSample*numChannels)
-            QCoreApplication::processEvents();
-
-        stopRecording(true);
-    });
     connect(counter, &QTimer::timeout, this, &MainWindow::updateTimeLabel);
+    // capture device emits from inside of QAudioInput's write, bytes must be copied to saver before it returns
+    connect(&capture, &CaptureDevice::captured, this, &MainWindow::processCaptured, Qt::DirectConnection);
+    connect(&capture, &CaptureDevice::segmentFinished, this, &MainWindow::finishSegment, Qt::DirectConnection);
+    connect(&saver, &RecordingSaver::saved, this, &MainWindow::showSpectogram);
+    connect(&saver, &RecordingSaver::failed, this, &MainWindow::showSaveError);
 }
 
 MainWindow::~MainWindow()
@@ -60,24 +51,6 @@ MainWindow::~MainWindow()
     delete ui;
 }
 
-QImage MainWindow::spectogramToImg(const MatrixMath::vec2d & v){
-    const long double minValSrc = MatrixMath::minMatrix(v);
-    const long double maxValSrc = MatrixMath::maxMatrix(v);
-    const long double colorMax = 0; // red in HSV
-    const long double colorMin = 240; // dark blue in HSV
-    const long double a = (colorMax - colorMin)/(maxValSrc - minValSrc);
-    const long double b = colorMin - a * minValSrc;
-    QImage img = QImage(v[0].size(), v.size(), QImage::Format_RGB32);
-
-    for(unsigned int i = 0; i < v.size(); i++){
-        for(unsigned int j = 0; j < v[i].size(); j++){
-            QColor c = QColor::fromHsv(a*v[i][j] + b, 255, 255);
-            img.setPixelColor(j, i, c);
-        }
-    }
-    return img;
-}
-
 QAudioDeviceInfo MainWindow::getAudioDevice(QString name) {
     QAudioDeviceInfo device;
     QList<QAudioDeviceInfo> devices = QAudioDeviceInfo::availableDevices(QAudio::AudioInput);
@@ -143,6 +116,8 @@ bool MainWindow::validateInputs(){
         errText = "FFT input is empty.";
     else if(ui->FFTPointsInput->text().toInt() < 1)
         errText = "FFT input can't be less than 1.";
+    else if(ui->FFTPointsInput->text().toInt() & (ui->FFTPointsInput->text().toInt() - 1))
+        errText = "FFT input must be a power of 2.";
 
     // filter banks
     else if(ui->filterBanksInput->text() == "")
@@ -225,40 +200,32 @@ bool MainWindow::validateFormat(QAudioFormat format){
     return 1;
 }
 
-void MainWindow::prepareClassFolder(){
-    QDir dir;
-    dir.setPath(ui->directoryDisplay->text());
-    if(!dir.exists(ui->classInput->text())){
-        dir.mkdir(ui->classInput->text());
-    }
-}
-
-QString MainWindow::findAvailableFilename(){
-    static int fname = 1; // keep it static so it won't iterate over whole dataset everytime it needs to save a file
-
-    QDir dir;
-    dir.setPath(ui->directoryDisplay->text());
-    dir.cd(ui->classInput->text());
-
-    QString format = ".txt";
+SpectogramFormat MainWindow::getFileFormat(){
     if(ui->fileFormat->currentText() == "Numpy array")
-        format = ".npy";
-    else if(ui->fileFormat->currentText() == "JPG color image" || ui->fileFormat->currentText() == "JPG grayscale image")
-        format = ".jpg";
-
-    while(dir.exists(QString::number(fname) + format)){
-        fname++;
-    }
-    return QString::number(fname) + format;
+        return SpectogramFormat::Numpy;
+    else if(ui->fileFormat->currentText() == "JPG color image")
+        return SpectogramFormat::ColorImage;
+    else if(ui->fileFormat->currentText() == "JPG grayscale image")
+        return SpectogramFormat::GrayscaleImage;
+    else if(ui->fileFormat->currentText() == "Dataset shards")
+        return SpectogramFormat::Shard;
+    return SpectogramFormat::PlainText;
 }
 
-MatrixMath::vec2d MainWindow::processAudioBuffer(){
+MainWindow::Processor::config MainWindow::getProcessorConfig(){
     const unsigned int bytesPerSample = ui->sampleSize->currentText().toInt()/8;
     const unsigned int numberOfChannels = ui->channelCountInput->text().toInt();
     const unsigned int sampleRate = ui->sampleRateInput->text().toInt();
-    const long double emphasisCoeff = static_cast<long double>(ui->preEmphasisInput->text().toDouble());
+    const Scalar emphasisCoeff = static_cast<Scalar>(ui->preEmphasisInput->text().toDouble());
     const unsigned int frameSize = ui->frameSizeInput->text().toInt();
     const unsigned int frameStride = ui->frameStrideInput->text().toInt();
+    WindowFunction window = WindowFunction::Hamming;
+    if(ui->windowInput->currentText() == "Hann")
+        window = WindowFunction::Hann;
+    else if(ui->windowInput->currentText() == "Blackman")
+        window = WindowFunction::Blackman;
+    else if(ui->windowInput->currentText() == "Rectangular")
+        window = WindowFunction::Rectangular;
     const unsigned int NFFT = ui->FFTPointsInput->text().toInt();
     const unsigned int numFilterBanks = ui->filterBanksInput->text().toInt();
     const bool MFCC = ui->resultMatrix->currentText() == "MFCC";
@@ -268,16 +235,17 @@ MatrixMath::vec2d MainWindow::processAudioBuffer(){
     const unsigned int cepLifter = ui->cepLiftersInput->text().toInt();
     const bool normalize = ui->normalizeData->currentText() == "Normalize";
     const bool rescale = ui->rescaleInput->currentText() == "Rescale";
-    const long double scaleMin = static_cast<long double>(ui->rescaleMinInput->text().toDouble());
-    const long double scaleMax = static_cast<long double>(ui->rescaleMaxInput->text().toDouble());
+    const Scalar scaleMin = static_cast<Scalar>(ui->rescaleMinInput->text().toDouble());
+    const Scalar scaleMax = static_cast<Scalar>(ui->rescaleMaxInput->text().toDouble());
 
-    AudioProcessor::config conf = {
+    Processor::config conf = {
         bytesPerSample,
         numberOfChannels,
         sampleRate,
         emphasisCoeff,
         frameSize,
         frameStride,
+        window,
         NFFT,
         numFilterBanks,
         MFCC,
@@ -291,86 +259,62 @@ MatrixMath::vec2d MainWindow::processAudioBuffer(){
         scaleMax
     };
 
-    AudioProcessor audioProc(conf);
-    AudioProcessor::byteVec byteData(audioBuf.buffer().begin(), audioBuf.buffer().end());
-
-    MatrixMath::vec2d spectogram;
-    spectogram = audioProc.processBuffer(byteData);
-
-    return spectogram;
+    return conf;
 }
 
-void MainWindow::savePlain(QString fname, QString dname, const MatrixMath::vec2d & data){
-    QFile file(dname + "/" + fname);
-    if(!file.open(QIODevice::WriteOnly)){
-        QMessageBox msgBox;
-        msgBox.setText("Couldn't open file for save.");
-        msgBox.exec();
-        return;
-    }
-
-    QTextStream out(&file);
-    for(unsigned int i = 0; i < data.size(); i++){
-        for(unsigned int j = 0; j < data[i].size(); j++){
-            out << static_cast<double>(data[i][j]) << " ";
-        }
-        out << '\n';
-    }
-
-    file.close();
+qint64 MainWindow::fixedDurationBufferSize(){
+    const qint64 sampleRate = ui->sampleRateInput->text().toInt();
+    const qint64 numChannels = ui->channelCountInput->text().toInt();
+    const qint64 bytesPerSample = ui->sampleSize->currentText().toInt()/8;
+    const qint64 recordDuration = ui->durationInput->text().toInt();
+    // whole number of samples so every segment ends at sample boundary
+    return sampleRate * recordDuration / 1000 * bytesPerSample * numChannels;
 }
 
-void MainWindow::saveColorImg(QString fname, QString dname, const QImage & img){
-    img.save(dname + "/" + fname + ".jpg");
+void MainWindow::processCaptured(const char *data, qint64 size){
+    saver.push(data, size);
 }
 
-void MainWindow::saveGrayscaleImg(QString fname, QString dname, const QImage & img){
-    QImage gray = img.convertToFormat(QImage::Format_Grayscale8);
-    gray.save(dname + "/" + fname);
-}
+void MainWindow::finishSegment(){
+    saveRecording();
 
-void MainWindow::saveNumpy(QString fname, QString dname, const MatrixMath::vec2d & data){
-    std::string f = fname.toStdString();
-    std::string d = dname.toStdString();
+    secs = 0;
+    mins = 0;
+    setTimeLabel();
 
-    MatrixMath::vec data1d(data.size() * data[0].size());
-    for(unsigned int i = 0; i < data.size(); i++){
-        if(i == 0)
-            std::copy(data[i].begin(), data[i].end(), data1d.begin());
-        else
-            std::copy(data[i].begin(), data[i].end(), data1d.begin() + i*data[i-1].size());
+    if(capture.isFinished()){
+        // input can't be stopped from inside of it's own write so stop it after write returns
+        QMetaObject::invokeMethod(this, [this](){
+            if(audioInput)
+                stopRecording();
+        }, Qt::QueuedConnection);
+        return;
     }
 
-    cnpy::npy_save(d + "/" + f, &data1d[0], {data[0].size(), data[0].size()}, "w");
+    // input keeps running so next repeat starts with the very next sample
+    if(ui->repeatCuesInput->isChecked())
+        startSound.play(); // doesn't wait for sound to finish
 }
 
 void MainWindow::saveRecording(){
-    MatrixMath::vec2d spectogram = processAudioBuffer();
+    RecordingSaver::Recording recording;
+    recording.root = ui->directoryDisplay->text();
+    recording.className = ui->classInput->text();
+    recording.format = getFileFormat();
 
-    // create QImage from spectogram and display it and maybe save as jpg if it's selected
-    QImage spectogramImg = spectogramToImg(spectogram);
-    ui->spectogramLabel->setPixmap(QPixmap::fromImage(spectogramImg.scaled(QSize(ui->spectogramLabel->width(), ui->spectogramLabel->height()))));
-
-    prepareClassFolder();
-
-    QString fileName = findAvailableFilename();
+    // saver already processed or queued every captured byte
+    saver.save(recording);
+}
 
-    QDir dir;
-    dir.setPath(ui->directoryDisplay->text());
-    dir.cd(ui->classInput->text());
+void MainWindow::showSpectogram(QImage spectogram, QString stats){
+    ui->spectogramLabel->setPixmap(QPixmap::fromImage(spectogram.scaled(QSize(ui->spectogramLabel->width(), ui->spectogramLabel->height()))));
+    statusBar()->showMessage(stats);
+}
 
-    if(ui->fileFormat->currentText() == "Plain text"){
-        savePlain(fileName, dir.path(), spectogram);
-    }
-    else if(ui->fileFormat->currentText() == "Numpy array"){
-        saveNumpy(fileName, dir.path(), spectogram);
-    }
-    else if(ui->fileFormat->currentText() == "JPG color image"){
-        saveColorImg(fileName, dir.path(), spectogramImg);
-    }
-    else if(ui->fileFormat->currentText() == "JPG grayscale image"){
-        saveGrayscaleImg(fileName, dir.path(), spectogramImg);
-    }
+void MainWindow::showSaveError(QString message){
+    QMessageBox msgBox;
+    msgBox.setText(message);
+    msgBox.exec();
 }
 
 void MainWindow::setTimeLabel(){
@@ -379,12 +323,6 @@ void MainWindow::setTimeLabel(){
     ui->timeLabel->setText(minStr + ":" + secStr);
 }
 
-void MainWindow::closeAndClearAudioBuffer(){
-    audioBuf.buffer().clear();
-    audioBuf.reset();
-    audioBuf.close();
-}
-
 void MainWindow::uxRecording(){
     // disable all recording buttons for now
     ui->stopButton->setEnabled(false);
@@ -491,84 +429,50 @@ void MainWindow::startRecording(){
 
     uxRecording();
 
-    audioInput = new QAudioInput(getAudioDevice(ui->recorderDevice->currentText()),format, this);
+    // spectogram is computed on saver's thread while recording
+    const bool fixedDuration = ui->recordType->currentText() == "Fixed duration";
+    saver.startStream(getProcessorConfig(), fixedDuration ? static_cast<std::size_t>(fixedDurationBufferSize()) : 0);
 
-    audioBuf.open(QIODevice::ReadWrite);
+    // fixed duration recordings are closed by capture device the moment their last byte arrives,
+    // START REPEAT keeps single input running and cuts it into consecutive recordings
+    if(fixedDuration)
+        capture.startCapture(fixedDurationBufferSize(), isRepeating ? ui->numRepeatsInput->text().toULong() : 1);
+    else
+        capture.startCapture(0, 0);
 
-    counter->start(1000);
-    audioInput->start(&audioBuf);
+    audioInput = new QAudioInput(getAudioDevice(ui->recorderDevice->currentText()),format, this);
 
-    if(ui->recordType->currentText() == "Fixed duration"){
-        recorder->start(ui->durationInput->text().toInt());
-    }
+    counter->start(1000);
+    audioInput->start(&capture);
 
     QCoreApplication::processEvents(); // ??? required as without it app lags a bit if mouse has not moved which also affects recording device
 }
 
-void MainWindow::stopRecording(bool fixedDurationSuccess){
+void MainWindow::stopRecording(){
     audioInput->stop();
-    recorder->stop();
     counter->stop();
 
     delete audioInput;
+    audioInput = nullptr;
 
-    if(ui->recordType->currentText() == "Fixed duration"){
-
-        // fixed duration recording finished successfully
-        if(fixedDurationSuccess){
-            // make sure that there is expected number of sample in buffer
-            // if there is too many samples then trim buffer
-            // if there is less then append zeros
-            const int sampleRate = ui->sampleRateInput->text().toInt();
-            const int numChannels = ui->channelCountInput->text().toInt();
-            const int bytesPerSample = ui->sampleSize->currentText().toInt()/8;
-            const int recordDuration = ui->durationInput->text().toInt();
-            const int expectedBufferSize = sampleRate * bytesPerSample * numChannels * recordDuration*0.001;
-            if(audioBuf.buffer().size() > expectedBufferSize){
-                const int diff = audioBuf.buffer().size() - expectedBufferSize;
-                audioBuf.buffer().remove(expectedBufferSize, diff);
-            }
-            else if(audioBuf.buffer().size() < expectedBufferSize){
-                const int diff = expectedBufferSize - audioBuf.buffer().size();
-                audioBuf.buffer().append(diff, 0);
-            }
-
-            saveRecording();
-
-            closeAndClearAudioBuffer();
-
-            // repeat recording if START REPEAT was clicked
-
-            if(isRepeating){
-                repeatCntr++;
-                if(repeatCntr < ui->numRepeatsInput->text().toInt() || ui->numRepeatsInput->text().toInt() == 0)
-                    startRecording();
-                else
-                    isRepeating = false;
-            }
-        }
-        // recording stopped using STOP button so clear stuff and finish
-        else{
-            isRepeating = false;
+    capture.close();
 
-            closeAndClearAudioBuffer();
-        }
-    }
     // until stopped recording stopped by user so save stuff
-    else{
-
+    if(ui->recordType->currentText() != "Fixed duration"){
         saveRecording();
-
-        closeAndClearAudioBuffer();
+    }
+    // fixed duration recordings are saved as soon as they are complete so drop unfinished one
+    else{
+        saver.dropRecording();
     }
 
+    isRepeating = false;
+
     secs = 0;
     mins = 0;
     setTimeLabel();
 
-    if(!isRepeating){
-        uxIdle();
-    }
+    uxIdle();
 }
 
 void MainWindow::on_recordType_currentIndexChanged(const QString &arg1)
@@ -598,8 +502,7 @@ void MainWindow::on_directoryButton_clicked()
 
 void MainWindow::on_stopButton_clicked()
 {
-    bool flag = ui->recordType->currentText() == "Fixed duration" ? false : true;
-    stopRecording(flag);
+    stopRecording();
 }
 
 void MainWindow::on_startButton_clicked()
@@ -611,7 +514,6 @@ void MainWindow::on_startButton_clicked()
 void MainWindow::on_startRepeatButton_clicked()
 {
     isRepeating = true;
-    repeatCntr = 0;
     startRecording();
 }
 
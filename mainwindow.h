@@ -3,11 +3,13 @@
 
 #include <QMainWindow>
 #include <QAudioInput>
-#include <QBuffer>
 #include <QSound>
 #include <QImage>
 
 #include "audioprocessor.h"
+#include "spectogramwriter.h"
+#include "recordingsaver.h"
+#include "capturedevice.h"
 
 namespace Ui {
 class MainWindow;
@@ -35,9 +37,10 @@ private slots:
     void updateTimeLabel();
 
     /**
-     * @brief Do all stuff required to stop recording audio. Stop recorder, play stop.wav, save record, clear audio buffer and restart recording if necessary.
+     * @brief Do all stuff required to stop recording audio. Stop recorder, play stop.wav and save "until stopped" record.
+     * Unfinished fixed duration record is dropped.
      */
-    void stopRecording(bool fixedDurationSuccess);
+    void stopRecording();
 
     void on_resultMatrix_currentTextChanged(const QString &arg1);
 
@@ -45,10 +48,38 @@ private slots:
 
     void on_rescaleInput_currentTextChanged(const QString &arg1);
 
+    /**
+     * @brief Hand captured audio data over to background saver which computes spectogram while recording.
+     * @param data Captured bytes.
+     * @param size Number of bytes.
+     */
+    void processCaptured(const char *data, qint64 size);
+
+    /**
+     * @brief Save fixed duration recording whose last byte has just been captured and stop recording after last one.
+     */
+    void finishSegment();
+
+    /**
+     * @brief Display spectogram of recording saved in background and it's processing stats in status bar.
+     * @param spectogram Heatmap of spectogram.
+     * @param stats Time and memory spent on spectogram.
+     */
+    void showSpectogram(QImage spectogram, QString stats);
+
+    /**
+     * @brief Inform user that recording couldn't be saved.
+     * @param message Description of error.
+     */
+    void showSaveError(QString message);
+
 private:
+    typedef RecordingSaver::Scalar Scalar;
+    typedef RecordingSaver::Processor Processor;
+    typedef MatrixMath<Scalar> Math;
+
     Ui::MainWindow *ui;
 
-    QTimer *recorder; //!< For fixed duration stop after duration has passed.
     QTimer *counter; //!< Update time label.
 
     int mins = 0; //!< Keep number of minutes since start of recording.
@@ -58,17 +89,11 @@ private:
     QSound stopSound; //!< Play stop.wav.
 
     bool isRepeating = false; //!< True when START REPEAT is used, false otherwise.
-    unsigned long repeatCntr = 0; //!< Used to track number of repeats
 
-    QAudioInput *audioInput; //!< Device used to record data.
-    QBuffer audioBuf; //!< Raw audio data is stored here.
+    QAudioInput *audioInput = nullptr; //!< Device used to record data.
+    CaptureDevice capture; //!< Receives raw audio data from audioInput and splits it into fixed duration recordings.
 
-    /**
-     * @brief Use obtained spectogram data to obtain it's heatmap.
-     * @param v Matrix to get heatmap from.
-     * @return QImage with heatmap.
-     */
-    QImage spectogramToImg(const MatrixMath::vec2d & v);
+    RecordingSaver saver; //!< Computes spectograms of captured audio and saves recordings in background.
 
     /**
      * @brief Get info about device of given name.
@@ -91,59 +116,26 @@ private:
     bool validateFormat(QAudioFormat format);
 
     /**
-     * @brief Creates class folder inside dataset's root directory. If exists then nothing happens.
-     */
-    void prepareClassFolder();
-
-    /**
-     * @brief Finds closest available file name, i.e first recording will be called "1", second "2" etc.
-     * If there are files "1" and "3", "2" will be used as file name.
-     *
-     * @return Available file name.
-     */
-    QString findAvailableFilename();
-
-    /**
-     * @brief Process obtained audio/pcm samples and receive matrix containing it's spectogram.
-     *
-     * @return Spectogram of audio buffer
-     */
-    MatrixMath::vec2d processAudioBuffer();
-
-    /**
-     * @brief Save spectogram in plain .txt.
-     * @param Filename.
-     * @param Directory path.
-     * @param Spectogram data.
-     */
-    void savePlain(QString fname, QString dname, const MatrixMath::vec2d & data);
-
-    /**
-     * @brief Save spectogram as color image in .jpg format.
-     * @param Filename.
-     * @param Directory path.
-     * @param Spectogram data.
+     * @brief Read selected file format from UI.
+     * @return Format of saved spectograms.
      */
-    void saveColorImg(QString fname, QString dname, const QImage & img);
+    SpectogramFormat getFileFormat();
 
     /**
-     * @brief Save spectogram as grayscale image in .jpg format.
-     * @param Filename.
-     * @param Directory path.
-     * @param Spectogram data.
+     * @brief Read config of audio processor from UI.
+     * @return Config of audio processor.
      */
-    void saveGrayscaleImg(QString fname, QString dname, const QImage & img);
+    Processor::config getProcessorConfig();
 
     /**
-     * @brief Save spectogram as numpy array .npy.
-     * @param Filename.
-     * @param Directory path.
-     * @param Spectogram data.
+     * @brief Compute size of audio buffer of fixed duration recording.
+     * @return Size in bytes.
      */
-    void saveNumpy(QString fname, QString dname, const MatrixMath::vec2d & data);
+    qint64 fixedDurationBufferSize();
 
     /**
-     * @brief Save recorded and processed audio to file under given in UI directory.
+     * @brief Let background saver save every byte captured since previous recording under given in UI directory.
+     * Bytes captured afterwards belong to next recording.
      */
     void saveRecording();
 
@@ -154,12 +146,6 @@ private:
      */
     void setTimeLabel();
 
-    /**
-     * @brief clear content of internal buffer of "audioBuf",
-     * reset pointer of audioBuf and close file descriptor.
-     */
-    void closeAndClearAudioBuffer();
-
     /**
      * @brief Disables every part of UI except STOP button which is being enabled. Used when recording starts.
      */
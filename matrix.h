@@ -0,0 +1,182 @@
+#ifndef MATRIX_H
+#define MATRIX_H
+
+#include <vector>
+#include <new>
+#include <cstddef>
+#include <algorithm>
+
+/**
+ * @brief Allocator that aligns every allocation to given number of bytes.
+ * @tparam T Type of allocated elements.
+ * @tparam Alignment Alignment in bytes, power of two.
+ */
+template<typename T, std::size_t Alignment = 64>
+class AlignedAllocator{
+public:
+    typedef T value_type;
+
+    template<typename U>
+    struct rebind{
+        typedef AlignedAllocator<U, Alignment> other;
+    };
+
+    AlignedAllocator() noexcept {}
+
+    template<typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment> &) noexcept {}
+
+    T * allocate(std::size_t n){
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Alignment)));
+    }
+
+    void deallocate(T * p, std::size_t){
+        ::operator delete(p, std::align_val_t(Alignment));
+    }
+
+    template<typename U>
+    bool operator==(const AlignedAllocator<U, Alignment> &) const noexcept {return true;}
+
+    template<typename U>
+    bool operator!=(const AlignedAllocator<U, Alignment> &) const noexcept {return false;}
+};
+
+/**
+ * @brief Row major matrix stored in single aligned allocation.
+ *
+ * Matrix either owns it's elements or is a view into elements of other matrix.
+ * Rows of owning matrix are stored one after another (stride equals number of columns),
+ * rows of a view are stride elements apart. Copy of any matrix is always owning and contiguous.
+ *
+ * @tparam T Type of elements.
+ */
+template<typename T>
+class Matrix{
+private:
+    std::vector<T, AlignedAllocator<T>> storage; //!< Elements of owning matrix, empty for views.
+    T * ptr = nullptr; //!< First element of matrix.
+    std::size_t numRows = 0;
+    std::size_t numCols = 0;
+    std::size_t rowStride = 0; //!< Distance in elements between beginnings of consecutive rows.
+    bool owning = true;
+
+public:
+    /**
+     * @brief Create empty matrix.
+     */
+    Matrix(){}
+
+    /**
+     * @brief Create owning matrix of given shape.
+     * @param rows Number of rows.
+     * @param cols Number of columns.
+     * @param value Initial value of every element.
+     */
+    Matrix(std::size_t rows, std::size_t cols, T value = 0)
+        : storage(rows * cols, value), ptr(storage.data()), numRows(rows), numCols(cols), rowStride(cols) {}
+
+    /**
+     * @brief Create view into existing elements.
+     * @param data First element of view.
+     * @param rows Number of rows.
+     * @param cols Number of columns.
+     * @param stride Distance in elements between beginnings of consecutive rows.
+     */
+    Matrix(T * data, std::size_t rows, std::size_t cols, std::size_t stride)
+        : ptr(data), numRows(rows), numCols(cols), rowStride(stride), owning(false) {}
+
+    Matrix(const Matrix & other)
+        : storage(other.numRows * other.numCols), ptr(storage.data()), numRows(other.numRows), numCols(other.numCols), rowStride(other.numCols) {
+        for(std::size_t i = 0; i < numRows; i++)
+            std::copy(other.row(i), other.row(i) + numCols, row(i));
+    }
+
+    Matrix(Matrix && other) noexcept {swap(other);}
+
+    Matrix & operator=(Matrix other) noexcept {
+        swap(other);
+        return *this;
+    }
+
+    void swap(Matrix & other) noexcept {
+        storage.swap(other.storage);
+        std::swap(ptr, other.ptr);
+        std::swap(numRows, other.numRows);
+        std::swap(numCols, other.numCols);
+        std::swap(rowStride, other.rowStride);
+        std::swap(owning, other.owning);
+    }
+
+    std::size_t rows() const {return numRows;}
+    std::size_t cols() const {return numCols;}
+    std::size_t stride() const {return rowStride;}
+    bool empty() const {return numRows == 0 || numCols == 0;}
+
+    /**
+     * @brief Get number of elements owning matrix can hold without reallocation.
+     * @return Capacity in elements, 0 for views.
+     */
+    std::size_t capacity() const {return storage.capacity();}
+
+    /**
+     * @brief Check whether matrix is a view into elements of other matrix.
+     * @return True if matrix does not own it's elements.
+     */
+    bool isView() const {return !owning;}
+
+    /**
+     * @brief Check whether rows are stored one after another without gaps.
+     * @return True if all elements can be accessed as single array of rows() * cols() elements.
+     */
+    bool isContiguous() const {return rowStride == numCols || numRows <= 1;}
+
+    T * data() {return ptr;}
+    const T * data() const {return ptr;}
+
+    T * row(std::size_t i) {return ptr + i * rowStride;}
+    const T * row(std::size_t i) const {return ptr + i * rowStride;}
+
+    T & operator()(std::size_t i, std::size_t j) {return ptr[i * rowStride + j];}
+    const T & operator()(std::size_t i, std::size_t j) const {return ptr[i * rowStride + j];}
+
+    /**
+     * @brief Create view into rectangular part of matrix.
+     * @param firstRow First row of view.
+     * @param rows Number of rows of view.
+     * @param firstCol First column of view.
+     * @param cols Number of columns of view.
+     * @return View sharing elements with this matrix.
+     */
+    Matrix view(std::size_t firstRow, std::size_t rows, std::size_t firstCol, std::size_t cols){
+        return Matrix(row(firstRow) + firstCol, rows, cols, rowStride);
+    }
+
+    /**
+     * @brief Change shape of owning matrix. Memory is reallocated only when current capacity is too small.
+     * Values of elements are unspecified after resize.
+     * @param rows New number of rows.
+     * @param cols New number of columns.
+     */
+    void resize(std::size_t rows, std::size_t cols){
+        if(!owning){
+            *this = Matrix(rows, cols);
+            return;
+        }
+        storage.resize(rows * cols);
+        ptr = storage.data();
+        numRows = rows;
+        numCols = cols;
+        rowStride = cols;
+    }
+
+    /**
+     * @brief Set every element of matrix to given value.
+     * @param value Value to set.
+     */
+    void fill(T value){
+        for(std::size_t i = 0; i < numRows; i++)
+            std::fill(row(i), row(i) + numCols, value);
+    }
+};
+
+#endif // MATRIX_H
@@ -0,0 +1,127 @@
+#include "recordingsaver.h"
+
+#include <QDir>
+
+RecordingSaver::RecordingSaver(QObject *parent) : QObject(parent)
+{
+    stream.setThreadPool(&threadPool);
+    context.moveToThread(&thread);
+    thread.start();
+}
+
+RecordingSaver::~RecordingSaver()
+{
+    // events are delivered in order so quit runs after every queued chunk and recording is processed
+    QMetaObject::invokeMethod(&context, [this](){thread.quit();}, Qt::QueuedConnection);
+    thread.wait();
+}
+
+void RecordingSaver::startStream(const Processor::config & conf, std::size_t reserveBytes){
+    QMetaObject::invokeMethod(&context, [this, conf, reserveBytes](){
+        stream.setConfig(conf);
+        streamReserve = reserveBytes;
+        nextRecording();
+    }, Qt::QueuedConnection);
+}
+
+void RecordingSaver::push(const char * data, qint64 size){
+    // capture reuses it's buffer as soon as this returns
+    const QByteArray bytes(data, static_cast<int>(size));
+
+    QMetaObject::invokeMethod(&context, [this, bytes](){
+        if(streamFailed)
+            return;
+        try{
+            stream.pushBytes(reinterpret_cast<const unsigned char*>(bytes.constData()), static_cast<std::size_t>(bytes.size()));
+        }
+        catch(const AudioProcessorException & e){
+            streamFailed = true; // report once, not for every following chunk
+            emit failed(e.what());
+        }
+    }, Qt::QueuedConnection);
+}
+
+void RecordingSaver::save(const Recording & recording){
+    QMetaObject::invokeMethod(&context, [this, recording](){
+        if(!streamFailed)
+            process(recording);
+        nextRecording();
+    }, Qt::QueuedConnection);
+}
+
+void RecordingSaver::dropRecording(){
+    QMetaObject::invokeMethod(&context, [this](){nextRecording();}, Qt::QueuedConnection);
+}
+
+void RecordingSaver::nextRecording(){
+    stream.resetStream();
+    stream.reserveStream(streamReserve);
+    streamFailed = false;
+}
+
+void RecordingSaver::process(const Recording & recording){
+    Processor::vec2d spectogram;
+    Processor::Stats stats;
+    try{
+        spectogram = stream.finish(&stats);
+    }
+    catch(const AudioProcessorException & e){
+        emit failed(e.what());
+        return;
+    }
+
+    // the same image is saved and previewed, grayscale is rendered directly instead of converted from colors
+    QImage spectogramImg = Writer::toImage(spectogram, recording.format == SpectogramFormat::GrayscaleImage);
+
+    Writer::prepareClassFolder(recording.root, recording.className);
+
+    QDir dir;
+    dir.setPath(recording.root);
+    dir.cd(recording.className);
+
+    DatasetManifest::Entry entry;
+    if(!manifest.reserveId(dir.path(), entry.id)){
+        emit failed("Couldn't open manifest of class.");
+        return;
+    }
+    entry.rows = spectogram.rows();
+    entry.cols = spectogram.cols();
+    entry.configHash = stream.getConfig().hash();
+
+    if(recording.format == SpectogramFormat::Shard){
+        uint32_t shardNumber, clipIndex;
+        if(!shards.append(dir.path(), spectogram, shardNumber, clipIndex)){
+            emit failed("Couldn't append spectogram to shard.");
+            return;
+        }
+        entry.file = DatasetShard::fileName(shardNumber);
+        entry.shard = shardNumber;
+        entry.clip = clipIndex;
+    }
+    else{
+        entry.file = QString::number(entry.id) + Writer::extension(recording.format);
+        if(!Writer::save(recording.format, entry.file, dir.path(), spectogram, spectogramImg)){
+            emit failed("Couldn't open file for save.");
+            return;
+        }
+    }
+
+    if(!manifest.append(dir.path(), entry)){
+        emit failed("Couldn't update manifest of class.");
+        return;
+    }
+
+    emit saved(spectogramImg, describeStats(stats));
+}
+
+QString RecordingSaver::describeStats(const Processor::Stats & stats){
+    return QString("%1x%2 in %3 ms (framing %4, features %5, finish %6), %7x real time, %8 MB allocated, largest matrix %9 MB")
+            .arg(stats.numFeatures).arg(stats.numFrames)
+            .arg(stats.totalSeconds * 1e3, 0, 'f', 1)
+            .arg(stats.framingSeconds * 1e3, 0, 'f', 1)
+            .arg(stats.featuresSeconds * 1e3, 0, 'f', 1)
+            .arg(stats.finishSeconds * 1e3, 0, 'f', 1)
+            .arg(stats.realTimeFactor(), 0, 'g', 2)
+            .arg(stats.allocatedBytes / 1048576.0, 0, 'f', 2)
+            .arg(stats.peakMatrixBytes / 1048576.0, 0, 'f', 2);
+}
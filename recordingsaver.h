@@ -0,0 +1,115 @@
+#ifndef RECORDINGSAVER_H
+#define RECORDINGSAVER_H
+
+#include <QObject>
+#include <QThread>
+#include <QImage>
+#include <QByteArray>
+
+#include "audioprocessor.h"
+#include "threadpool.h"
+#include "spectogramwriter.h"
+#include "datasetshard.h"
+#include "datasetmanifest.h"
+
+/**
+ * @brief Computes spectograms of captured audio and saves them on background thread, so capture and UI
+ * never wait for processing and recorder can start next capture right after previous one stops.
+ * Captured bytes and recordings are processed one after another in order they were queued.
+ */
+class RecordingSaver : public QObject
+{
+    Q_OBJECT
+
+public:
+    typedef float Scalar; //!< Precision of spectogram computations.
+    typedef AudioProcessor<Scalar> Processor;
+    typedef SpectogramWriter<Scalar> Writer;
+    typedef ShardWriter<Scalar> Shards;
+
+    /**
+     * @brief Destination of captured recording waiting to be saved.
+     */
+    struct Recording{
+        QString root; //!< Dataset's root directory.
+        QString className; //!< Name of class.
+        SpectogramFormat format = SpectogramFormat::PlainText; //!< Format of saved file.
+    };
+
+    explicit RecordingSaver(QObject *parent = nullptr);
+
+    /**
+     * @brief Class destructor. Waits until every queued recording is saved.
+     */
+    ~RecordingSaver();
+
+    /**
+     * @brief Start new stream of captured audio, unfinished recording of previous stream is dropped. Returns immediately.
+     * @param conf Config of audio processor.
+     * @param reserveBytes Expected number of bytes of every recording, 0 if unknown.
+     */
+    void startStream(const Processor::config & conf, std::size_t reserveBytes);
+
+    /**
+     * @brief Queue captured bytes to be processed on background thread. Bytes are copied so returns immediately.
+     * @param data Captured bytes.
+     * @param size Number of bytes.
+     */
+    void push(const char * data, qint64 size);
+
+    /**
+     * @brief Queue every byte pushed since previous recording to be saved as single recording on background thread,
+     * bytes pushed afterwards start next one. Returns immediately.
+     * @param recording Destination of recording.
+     */
+    void save(const Recording & recording);
+
+    /**
+     * @brief Drop every byte pushed since previous recording. Returns immediately.
+     */
+    void dropRecording();
+
+signals:
+    /**
+     * @brief Emitted from background thread after recording is saved.
+     * @param spectogram Heatmap of saved spectogram.
+     * @param stats Time and memory spent on spectogram, formatted for status bar.
+     */
+    void saved(QImage spectogram, QString stats);
+
+    /**
+     * @brief Emitted from background thread when recording couldn't be saved.
+     * @param message Description of error.
+     */
+    void failed(QString message);
+
+private:
+    QThread thread; //!< Thread that processes captured bytes and saves recordings.
+    QObject context; //!< Lives in thread, captured bytes and queued recordings are delivered to it as events.
+    ThreadPool threadPool; //!< Threads used by stream.
+    Processor stream; //!< Computes spectogram of current recording while it's being captured, used only by thread.
+    std::size_t streamReserve = 0; //!< Expected number of bytes of every recording of stream.
+    bool streamFailed = false; //!< True if processing of current recording failed and it's remaining bytes are ignored.
+    DatasetManifest manifest; //!< Gives ids of saved recordings and records them.
+    Shards shards; //!< Keeps current shard of every class open between recordings.
+
+    /**
+     * @brief Finish spectogram of stream and save it. Runs on background thread.
+     * @param recording Destination of recording.
+     */
+    void process(const Recording & recording);
+
+    /**
+     * @brief Prepare stream for next recording. Runs on background thread.
+     */
+    void nextRecording();
+
+    /**
+     * @brief Format processing stats for user.
+     * @param stats Stats of recording.
+     * @return Single line description.
+     */
+    static QString describeStats(const Processor::Stats & stats);
+};
+
+#endif // RECORDINGSAVER_H
@@ -0,0 +1,310 @@
+#ifndef SIMDKERNELS_H
+#define SIMDKERNELS_H
+
+#include <cstddef>
+#include <complex>
+
+// Widest instruction set enabled for the compiler is used, i.e build with -mavx2 (or /arch:AVX2) to use AVX2 kernels.
+// SSE2 is always available on x86-64 and NEON on AArch64, other targets and long double use scalar loops.
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SIMD_KERNELS_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SIMD_KERNELS_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SIMD_KERNELS_NEON
+#endif
+
+/**
+ * @brief Vectorized elementwise kernels used on every sample of every frame.
+ *
+ * Every kernel has scalar version for any type and explicitly vectorized overloads for float and double.
+ * Vectorized overloads process the tail of the array with scalar code so arrays don't need any padding.
+ */
+class SimdKernels{
+private:
+#if defined(SIMD_KERNELS_AVX2)
+    struct FloatOps{
+        typedef __m256 reg;
+        static const std::size_t width = 8;
+        static reg load(const float * p){return _mm256_loadu_ps(p);}
+        static void store(float * p, reg v){_mm256_storeu_ps(p, v);}
+        static reg set(float v){return _mm256_set1_ps(v);}
+        static reg add(reg a, reg b){return _mm256_add_ps(a, b);}
+        static reg sub(reg a, reg b){return _mm256_sub_ps(a, b);}
+        static reg mul(reg a, reg b){return _mm256_mul_ps(a, b);}
+        static reg replaceZeros(reg v, reg value){return _mm256_blendv_ps(v, value, _mm256_cmp_ps(v, _mm256_setzero_ps(), _CMP_EQ_OQ));}
+    };
+    struct DoubleOps{
+        typedef __m256d reg;
+        static const std::size_t width = 4;
+        static reg load(const double * p){return _mm256_loadu_pd(p);}
+        static void store(double * p, reg v){_mm256_storeu_pd(p, v);}
+        static reg set(double v){return _mm256_set1_pd(v);}
+        static reg add(reg a, reg b){return _mm256_add_pd(a, b);}
+        static reg sub(reg a, reg b){return _mm256_sub_pd(a, b);}
+        static reg mul(reg a, reg b){return _mm256_mul_pd(a, b);}
+        static reg replaceZeros(reg v, reg value){return _mm256_blendv_pd(v, value, _mm256_cmp_pd(v, _mm256_setzero_pd(), _CMP_EQ_OQ));}
+    };
+#elif defined(SIMD_KERNELS_SSE2)
+    struct FloatOps{
+        typedef __m128 reg;
+        static const std::size_t width = 4;
+        static reg load(const float * p){return _mm_loadu_ps(p);}
+        static void store(float * p, reg v){_mm_storeu_ps(p, v);}
+        static reg set(float v){return _mm_set1_ps(v);}
+        static reg add(reg a, reg b){return _mm_add_ps(a, b);}
+        static reg sub(reg a, reg b){return _mm_sub_ps(a, b);}
+        static reg mul(reg a, reg b){return _mm_mul_ps(a, b);}
+        static reg replaceZeros(reg v, reg value){
+            const reg mask = _mm_cmpeq_ps(v, _mm_setzero_ps());
+            return _mm_or_ps(_mm_and_ps(mask, value), _mm_andnot_ps(mask, v));
+        }
+    };
+    struct DoubleOps{
+        typedef __m128d reg;
+        static const std::size_t width = 2;
+        static reg load(const double * p){return _mm_loadu_pd(p);}
+        static void store(double * p, reg v){_mm_storeu_pd(p, v);}
+        static reg set(double v){return _mm_set1_pd(v);}
+        static reg add(reg a, reg b){return _mm_add_pd(a, b);}
+        static reg sub(reg a, reg b){return _mm_sub_pd(a, b);}
+        static reg mul(reg a, reg b){return _mm_mul_pd(a, b);}
+        static reg replaceZeros(reg v, reg value){
+            const reg mask = _mm_cmpeq_pd(v, _mm_setzero_pd());
+            return _mm_or_pd(_mm_and_pd(mask, value), _mm_andnot_pd(mask, v));
+        }
+    };
+#elif defined(SIMD_KERNELS_NEON)
+    struct FloatOps{
+        typedef float32x4_t reg;
+        static const std::size_t width = 4;
+        static reg load(const float * p){return vld1q_f32(p);}
+        static void store(float * p, reg v){vst1q_f32(p, v);}
+        static reg set(float v){return vdupq_n_f32(v);}
+        static reg add(reg a, reg b){return vaddq_f32(a, b);}
+        static reg sub(reg a, reg b){return vsubq_f32(a, b);}
+        static reg mul(reg a, reg b){return vmulq_f32(a, b);}
+        static reg replaceZeros(reg v, reg value){return vbslq_f32(vceqq_f32(v, vdupq_n_f32(0)), value, v);}
+    };
+#if defined(__aarch64__)
+    struct DoubleOps{
+        typedef float64x2_t reg;
+        static const std::size_t width = 2;
+        static reg load(const double * p){return vld1q_f64(p);}
+        static void store(double * p, reg v){vst1q_f64(p, v);}
+        static reg set(double v){return vdupq_n_f64(v);}
+        static reg add(reg a, reg b){return vaddq_f64(a, b);}
+        static reg sub(reg a, reg b){return vsubq_f64(a, b);}
+        static reg mul(reg a, reg b){return vmulq_f64(a, b);}
+        static reg replaceZeros(reg v, reg value){return vbslq_f64(vceqq_f64(v, vdupq_n_f64(0)), value, v);}
+    };
+#define SIMD_KERNELS_NEON_DOUBLE
+#endif
+#endif
+
+    template<typename Ops, typename T>
+    static std::size_t multiplyVec(T * dst, const T * src, std::size_t n){
+        std::size_t i = 0;
+        for(; i + Ops::width <= n; i += Ops::width)
+            Ops::store(dst + i, Ops::mul(Ops::load(dst + i), Ops::load(src + i)));
+        return i;
+    }
+
+    template<typename Ops, typename T>
+    static std::size_t subtractVec(T * dst, const T * src, std::size_t n){
+        std::size_t i = 0;
+        for(; i + Ops::width <= n; i += Ops::width)
+            Ops::store(dst + i, Ops::sub(Ops::load(dst + i), Ops::load(src + i)));
+        return i;
+    }
+
+    template<typename Ops, typename T>
+    static std::size_t affineVec(T * dst, std::size_t n, T a, T b){
+        const typename Ops::reg va = Ops::set(a);
+        const typename Ops::reg vb = Ops::set(b);
+        std::size_t i = 0;
+        for(; i + Ops::width <= n; i += Ops::width)
+            Ops::store(dst + i, Ops::add(Ops::mul(va, Ops::load(dst + i)), vb));
+        return i;
+    }
+
+    template<typename Ops, typename T>
+    static std::size_t replaceZerosVec(T * dst, std::size_t n, T value){
+        const typename Ops::reg vv = Ops::set(value);
+        std::size_t i = 0;
+        for(; i + Ops::width <= n; i += Ops::width)
+            Ops::store(dst + i, Ops::replaceZeros(Ops::load(dst + i), vv));
+        return i;
+    }
+
+    /**
+     * @brief Compute |z|^2 * scale for every complex number using SIMD, returns number of processed elements.
+     */
+    static std::size_t squaredMagnitudeVec(const std::complex<float> * src, float * dst, std::size_t n, float scale){
+        const float * p = reinterpret_cast<const float*>(src);
+        std::size_t i = 0;
+#if defined(SIMD_KERNELS_AVX2)
+        const __m256 vs = _mm256_set1_ps(scale);
+        for(; i + 8 <= n; i += 8){
+            const __m256 a = _mm256_loadu_ps(p + 2*i);
+            const __m256 b = _mm256_loadu_ps(p + 2*i + 8);
+            const __m256 a2 = _mm256_mul_ps(a, a);
+            const __m256 b2 = _mm256_mul_ps(b, b);
+            // per 128 bit lane: a0+a1, a2+a3, b0+b1, b2+b3, then restore order of lanes
+            const __m256 sums = _mm256_add_ps(_mm256_shuffle_ps(a2, b2, _MM_SHUFFLE(2,0,2,0)), _mm256_shuffle_ps(a2, b2, _MM_SHUFFLE(3,1,3,1)));
+            const __m256 ordered = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(sums), _MM_SHUFFLE(3,1,2,0)));
+            _mm256_storeu_ps(dst + i, _mm256_mul_ps(ordered, vs));
+        }
+#elif defined(SIMD_KERNELS_SSE2)
+        const __m128 vs = _mm_set1_ps(scale);
+        for(; i + 4 <= n; i += 4){
+            const __m128 a = _mm_loadu_ps(p + 2*i);
+            const __m128 b = _mm_loadu_ps(p + 2*i + 4);
+            const __m128 a2 = _mm_mul_ps(a, a);
+            const __m128 b2 = _mm_mul_ps(b, b);
+            const __m128 sums = _mm_add_ps(_mm_shuffle_ps(a2, b2, _MM_SHUFFLE(2,0,2,0)), _mm_shuffle_ps(a2, b2, _MM_SHUFFLE(3,1,3,1)));
+            _mm_storeu_ps(dst + i, _mm_mul_ps(sums, vs));
+        }
+#elif defined(SIMD_KERNELS_NEON)
+        const float32x4_t vs = vdupq_n_f32(scale);
+        for(; i + 4 <= n; i += 4){
+            const float32x4x2_t z = vld2q_f32(p + 2*i);
+            const float32x4_t sums = vaddq_f32(vmulq_f32(z.val[0], z.val[0]), vmulq_f32(z.val[1], z.val[1]));
+            vst1q_f32(dst + i, vmulq_f32(sums, vs));
+        }
+#else
+        (void)p; (void)dst; (void)n; (void)scale;
+#endif
+        return i;
+    }
+
+    static std::size_t squaredMagnitudeVec(const std::complex<double> * src, double * dst, std::size_t n, double scale){
+        const double * p = reinterpret_cast<const double*>(src);
+        std::size_t i = 0;
+#if defined(SIMD_KERNELS_AVX2)
+        const __m256d vs = _mm256_set1_pd(scale);
+        for(; i + 4 <= n; i += 4){
+            const __m256d a = _mm256_loadu_pd(p + 2*i);
+            const __m256d b = _mm256_loadu_pd(p + 2*i + 4);
+            // a0+a1, b0+b1, a2+a3, b2+b3, then restore order
+            const __m256d sums = _mm256_hadd_pd(_mm256_mul_pd(a, a), _mm256_mul_pd(b, b));
+            _mm256_storeu_pd(dst + i, _mm256_mul_pd(_mm256_permute4x64_pd(sums, _MM_SHUFFLE(3,1,2,0)), vs));
+        }
+#elif defined(SIMD_KERNELS_SSE2)
+        const __m128d vs = _mm_set1_pd(scale);
+        for(; i + 2 <= n; i += 2){
+            const __m128d a = _mm_loadu_pd(p + 2*i);
+            const __m128d b = _mm_loadu_pd(p + 2*i + 2);
+            const __m128d a2 = _mm_mul_pd(a, a);
+            const __m128d b2 = _mm_mul_pd(b, b);
+            _mm_storeu_pd(dst + i, _mm_mul_pd(_mm_add_pd(_mm_unpacklo_pd(a2, b2), _mm_unpackhi_pd(a2, b2)), vs));
+        }
+#elif defined(SIMD_KERNELS_NEON_DOUBLE)
+        const float64x2_t vs = vdupq_n_f64(scale);
+        for(; i + 2 <= n; i += 2){
+            const float64x2x2_t z = vld2q_f64(p + 2*i);
+            const float64x2_t sums = vaddq_f64(vmulq_f64(z.val[0], z.val[0]), vmulq_f64(z.val[1], z.val[1]));
+            vst1q_f64(dst + i, vmulq_f64(sums, vs));
+        }
+#else
+        (void)p; (void)dst; (void)n; (void)scale;
+#endif
+        return i;
+    }
+
+    template<typename T>
+    static std::size_t squaredMagnitudeVec(const std::complex<T> *, T *, std::size_t, T){return 0;}
+
+#if defined(SIMD_KERNELS_AVX2) || defined(SIMD_KERNELS_SSE2) || defined(SIMD_KERNELS_NEON)
+    static std::size_t multiplyVec(float * dst, const float * src, std::size_t n){return multiplyVec<FloatOps>(dst, src, n);}
+    static std::size_t subtractVec(float * dst, const float * src, std::size_t n){return subtractVec<FloatOps>(dst, src, n);}
+    static std::size_t affineVec(float * dst, std::size_t n, float a, float b){return affineVec<FloatOps>(dst, n, a, b);}
+    static std::size_t replaceZerosVec(float * dst, std::size_t n, float value){return replaceZerosVec<FloatOps>(dst, n, value);}
+#endif
+#if defined(SIMD_KERNELS_AVX2) || defined(SIMD_KERNELS_SSE2) || defined(SIMD_KERNELS_NEON_DOUBLE)
+    static std::size_t multiplyVec(double * dst, const double * src, std::size_t n){return multiplyVec<DoubleOps>(dst, src, n);}
+    static std::size_t subtractVec(double * dst, const double * src, std::size_t n){return subtractVec<DoubleOps>(dst, src, n);}
+    static std::size_t affineVec(double * dst, std::size_t n, double a, double b){return affineVec<DoubleOps>(dst, n, a, b);}
+    static std::size_t replaceZerosVec(double * dst, std::size_t n, double value){return replaceZerosVec<DoubleOps>(dst, n, value);}
+#endif
+
+    // types without vectorized version
+    template<typename T>
+    static std::size_t multiplyVec(T *, const T *, std::size_t){return 0;}
+    template<typename T>
+    static std::size_t subtractVec(T *, const T *, std::size_t){return 0;}
+    template<typename T>
+    static std::size_t affineVec(T *, std::size_t, T, T){return 0;}
+    template<typename T>
+    static std::size_t replaceZerosVec(T *, std::size_t, T){return 0;}
+
+public:
+    /**
+     * @brief Multiply arrays elementwise, dst[i] *= src[i].
+     * @param dst Array to multiply and result of operation.
+     * @param src Array to multiply by.
+     * @param n Number of elements.
+     */
+    template<typename T>
+    static void multiply(T * dst, const T * src, std::size_t n){
+        for(std::size_t i = multiplyVec(dst, src, n); i < n; i++)
+            dst[i] *= src[i];
+    }
+
+    /**
+     * @brief Subtract arrays elementwise, dst[i] -= src[i].
+     * @param dst Array to subtract from and result of operation.
+     * @param src Array to subtract.
+     * @param n Number of elements.
+     */
+    template<typename T>
+    static void subtract(T * dst, const T * src, std::size_t n){
+        for(std::size_t i = subtractVec(dst, src, n); i < n; i++)
+            dst[i] -= src[i];
+    }
+
+    /**
+     * @brief Apply affine transformation to every element, dst[i] = a * dst[i] + b.
+     * @param dst Array to transform and result of operation.
+     * @param n Number of elements.
+     * @param a Slope.
+     * @param b Intercept.
+     */
+    template<typename T>
+    static void affine(T * dst, std::size_t n, T a, T b){
+        for(std::size_t i = affineVec(dst, n, a, b); i < n; i++)
+            dst[i] = a*dst[i] + b;
+    }
+
+    /**
+     * @brief Replace every zero in array with given value.
+     * @param dst Array to modify.
+     * @param n Number of elements.
+     * @param value Value that replaces zeros.
+     */
+    template<typename T>
+    static void replaceZeros(T * dst, std::size_t n, T value){
+        for(std::size_t i = replaceZerosVec(dst, n, value); i < n; i++){
+            if(dst[i] == 0)
+                dst[i] = value;
+        }
+    }
+
+    /**
+     * @brief Compute scaled squared magnitude of every complex number, dst[i] = |src[i]|^2 * scale.
+     * @param src Array of complex numbers.
+     * @param dst Array that receives result of operation.
+     * @param n Number of elements.
+     * @param scale Value to multiply every squared magnitude by.
+     */
+    template<typename T>
+    static void squaredMagnitude(const std::complex<T> * src, T * dst, std::size_t n, T scale){
+        for(std::size_t i = squaredMagnitudeVec(src, dst, n, scale); i < n; i++)
+            dst[i] = (src[i].real() * src[i].real() + src[i].imag() * src[i].imag()) * scale;
+    }
+};
+
+#endif // SIMDKERNELS_H
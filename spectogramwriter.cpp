@@ -0,0 +1,242 @@
+#include "spectogramwriter.h"
+#include "audioprocessor.h"
+
+#include <QFile>
+#include <QColor>
+#include <QtEndian>
+
+#include <algorithm>
+#include <charconv>
+#include <clocale>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+template<typename T>
+QString SpectogramWriter<T>::extension(SpectogramFormat format){
+    switch(format){
+    case SpectogramFormat::Numpy:
+        return ".npy";
+    case SpectogramFormat::ColorImage:
+    case SpectogramFormat::GrayscaleImage:
+        return ".jpg";
+    case SpectogramFormat::Shard:
+        return ".shard";
+    default:
+        return ".txt";
+    }
+}
+
+namespace{
+    constexpr int colormapSize = 4096; //!< Number of colors of heatmap.
+
+    /**
+     * @brief Get heatmap colors from dark blue to red, computed on first use.
+     * @return Table of colormapSize colors.
+     */
+    const std::vector<QRgb> & colormap(){
+        static const std::vector<QRgb> colors = [](){
+            std::vector<QRgb> table(colormapSize);
+            const double colorMax = 0; // red in HSV
+            const double colorMin = 240.0 / 360.0; // dark blue in HSV
+            for(int k = 0; k < colormapSize; k++){
+                const double hue = colorMin + (colorMax - colorMin) * k / (colormapSize - 1);
+                table[k] = QColor::fromHsvF(hue, 1, 1).rgb();
+            }
+            return table;
+        }();
+        return colors;
+    }
+}
+
+template<typename T>
+QImage SpectogramWriter<T>::toImage(const vec2d & v, bool grayscale){
+    const T minValSrc = MatrixMath<T>::minMatrix(v);
+    const T maxValSrc = MatrixMath<T>::maxMatrix(v);
+    const int levels = grayscale ? 256 : colormapSize;
+    // constant matrix maps to first level instead of dividing by zero
+    const T a = maxValSrc > minValSrc ? (levels - 1) / (maxValSrc - minValSrc) : 0;
+    const T b = -a * minValSrc;
+
+    QImage img = QImage(static_cast<int>(v.cols()), static_cast<int>(v.rows()),
+                        grayscale ? QImage::Format_Grayscale8 : QImage::Format_RGB32);
+    const QRgb * colors = colormap().data();
+
+    for(std::size_t i = 0; i < v.rows(); i++){
+        const T * row = &v(i, 0);
+        uchar * line = img.scanLine(static_cast<int>(i));
+        for(std::size_t j = 0; j < v.cols(); j++){
+            const T level = a * row[j] + b + T(0.5);
+            const int index = level > 0 ? std::min(static_cast<int>(level), levels - 1) : 0; // NaN goes to 0 too
+            if(grayscale)
+                line[j] = static_cast<uchar>(index);
+            else
+                reinterpret_cast<QRgb*>(line)[j] = colors[index];
+        }
+    }
+    return img;
+}
+
+template<typename T>
+bool SpectogramWriter<T>::prepareClassFolder(const QString & root, const QString & className){
+    QDir dir;
+    dir.setPath(root);
+    if(!dir.exists(className)){
+        return dir.mkpath(className);
+    }
+    return true;
+}
+
+/**
+ * @brief Format single value as text. Uses floating point std::to_chars where standard library has it
+ * (GCC 11, MSVC 2019 16.4, recent libc++), otherwise snprintf, i.e with MinGW 8.1 of Qt 5.15.
+ * @param out First character of text.
+ * @param end End of buffer.
+ * @param value Value to format.
+ * @param precision Significant digits, negative for shortest text that reads back exactly.
+ * With snprintf max_digits10 digits are used instead, which read back exactly too.
+ * @return End of text or nullptr if it doesn't fit into buffer.
+ */
+template<typename T>
+static char * formatValue(char * out, char * end, T value, int precision){
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+    const std::to_chars_result result = precision < 0 ?
+                std::to_chars(out, end, value) :
+                std::to_chars(out, end, value, std::chars_format::general, precision);
+    return result.ec == std::errc() ? result.ptr : nullptr;
+#else
+    const int digits = precision < 0 ? std::numeric_limits<T>::max_digits10 : precision;
+    const int length = std::snprintf(out, static_cast<std::size_t>(end - out), "%.*Lg", digits, static_cast<long double>(value));
+    if(length < 0 || length >= end - out)
+        return nullptr;
+
+    // Qt applications run with locale of user, file always uses decimal point
+    std::replace(out, out + length, *std::localeconv()->decimal_point, '.');
+    return out + length;
+#endif
+}
+
+template<typename T>
+bool SpectogramWriter<T>::savePlain(const QString & fname, const QString & dname, const vec2d & data,
+                                    int precision, char delimiter){
+    QFile file(dname + "/" + fname);
+    if(!file.open(QIODevice::WriteOnly)){
+        return false;
+    }
+
+    // digits, sign, point and exponent of the longest value plus delimiter
+    const std::size_t maxValueChars = static_cast<std::size_t>(std::max(precision, std::numeric_limits<T>::max_digits10)) + 10;
+    const std::size_t maxChars = data.rows() * (data.cols() * maxValueChars + 1);
+
+    thread_local std::vector<char> buffer; // keeps capacity between saves
+    if(buffer.size() < maxChars)
+        buffer.resize(maxChars);
+
+    char * out = buffer.data();
+    char * const end = buffer.data() + buffer.size();
+    for(std::size_t i = 0; i < data.rows(); i++){
+        const T * row = &data(i, 0);
+        for(std::size_t j = 0; j < data.cols(); j++){
+            if(j)
+                *out++ = delimiter;
+            out = formatValue(out, end, row[j], precision);
+            if(!out)
+                return false;
+        }
+        *out++ = '\n';
+    }
+
+    const qint64 size = out - buffer.data();
+    const bool written = file.write(buffer.data(), size) == size;
+    file.close();
+    return written;
+}
+
+template<typename T>
+bool SpectogramWriter<T>::saveColorImg(const QString & fname, const QString & dname, const QImage & img){
+    return img.save(dname + "/" + fname);
+}
+
+template<typename T>
+bool SpectogramWriter<T>::saveGrayscaleImg(const QString & fname, const QString & dname, const QImage & img){
+    if(img.format() != QImage::Format_Grayscale8)
+        return img.convertToFormat(QImage::Format_Grayscale8).save(dname + "/" + fname);
+    return img.save(dname + "/" + fname);
+}
+
+/**
+ * @brief Convert rows of matrix into array of different type.
+ * @param data Matrix, might be a view.
+ * @param dst First element of destination array.
+ */
+template<typename Dst, typename T>
+static void convertRows(const Matrix<T> & data, char * dst){
+    for(std::size_t i = 0; i < data.rows(); i++){
+        const T * row = &data(i, 0);
+        for(std::size_t j = 0; j < data.cols(); j++){
+            const Dst value = static_cast<Dst>(row[j]);
+            std::memcpy(dst, &value, sizeof(value));
+            dst += sizeof(value);
+        }
+    }
+}
+
+template<typename T>
+bool SpectogramWriter<T>::saveNumpy(const QString & fname, const QString & dname, const vec2d & data, NumpyType type){
+    QFile file(dname + "/" + fname);
+    if(!file.open(QIODevice::WriteOnly)){
+        return false;
+    }
+
+    const char endian = QSysInfo::ByteOrder == QSysInfo::LittleEndian ? '<' : '>';
+    const std::size_t elementSize = type == NumpyType::Float32 ? 4 : 8;
+    QByteArray header = QString("{'descr': '%1f%2', 'fortran_order': False, 'shape': (%3, %4), }")
+            .arg(endian).arg(elementSize).arg(data.rows()).arg(data.cols()).toLatin1();
+
+    // NPY 1.0: magic, version, length of header, header padded with spaces and ended with newline
+    // so that array starts at multiple of 64 bytes
+    const int preambleSize = 10;
+    const int paddedSize = (preambleSize + header.size() + 1 + 63) / 64 * 64 - preambleSize;
+    header.append(QByteArray(paddedSize - header.size() - 1, ' '));
+    header.append('\n');
+
+    const std::size_t dataSize = data.rows() * data.cols() * elementSize;
+    QByteArray bytes(static_cast<int>(preambleSize + paddedSize + dataSize), Qt::Uninitialized);
+    char * dst = bytes.data();
+    std::memcpy(dst, "\x93NUMPY\x01\x00", 8);
+    qToLittleEndian<quint16>(static_cast<quint16>(paddedSize), dst + 8);
+    std::memcpy(dst + preambleSize, header.constData(), static_cast<std::size_t>(paddedSize));
+    dst += preambleSize + paddedSize;
+
+    if(type == NumpyType::Float32)
+        convertRows<float>(data, dst);
+    else
+        convertRows<double>(data, dst);
+
+    const bool written = file.write(bytes) == bytes.size();
+    file.close();
+    return written;
+}
+
+template<typename T>
+bool SpectogramWriter<T>::save(SpectogramFormat format, const QString & fname, const QString & dname,
+                               const vec2d & data, const QImage & img, const SaveOptions & options){
+    switch(format){
+    case SpectogramFormat::PlainText:
+        return savePlain(fname, dname, data, options.textPrecision, options.textDelimiter);
+    case SpectogramFormat::Numpy:
+        return saveNumpy(fname, dname, data, options.numpyType);
+    case SpectogramFormat::ColorImage:
+        return saveColorImg(fname, dname, img.isNull() ? toImage(data) : img);
+    case SpectogramFormat::GrayscaleImage:
+        return saveGrayscaleImg(fname, dname, img.isNull() ? toImage(data, true) : img);
+    case SpectogramFormat::Shard:
+        return false;
+    }
+    return false;
+}
+
+template class SpectogramWriter<float>;
+template class SpectogramWriter<double>;
+template class SpectogramWriter<long double>;
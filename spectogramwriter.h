@@ -0,0 +1,135 @@
+#ifndef SPECTOGRAMWRITER_H
+#define SPECTOGRAMWRITER_H
+
+#include <QString>
+#include <QImage>
+#include <QDir>
+
+#include "matrix.h"
+
+/**
+ * @brief File formats spectogram can be saved in.
+ */
+enum class SpectogramFormat{
+    PlainText,
+    Numpy,
+    ColorImage,
+    GrayscaleImage,
+    Shard //!< Appended to shared per class files by ShardWriter instead of saved as separate file.
+};
+
+/**
+ * @brief Element types of saved numpy arrays.
+ */
+enum class NumpyType{
+    Float32,
+    Float64
+};
+
+/**
+ * @brief Format specific options of saved spectograms.
+ */
+struct SaveOptions{
+    NumpyType numpyType = NumpyType::Float32; //!< Element type of numpy arrays.
+    int textPrecision = -1; //!< Significant digits of plain text values, negative for shortest text that reads back exactly.
+    char textDelimiter = ' '; //!< Separator of values in single row of plain text.
+};
+
+/**
+ * @brief Saves spectograms into dataset laid out as "root/class/N", ids N are given by DatasetManifest.
+ * Shared by GUI recorder and batch tool so both produce the same files.
+ * @tparam T Scalar type of spectogram, i.e float, double or long double.
+ */
+template<typename T>
+class SpectogramWriter{
+public:
+    typedef Matrix<T> vec2d;
+
+    /**
+     * @brief Get extension of files of given format.
+     * @param format File format.
+     * @return Extension including leading dot.
+     */
+    static QString extension(SpectogramFormat format);
+
+    /**
+     * @brief Use obtained spectogram data to obtain it's heatmap. Values are scaled between minimum and maximum
+     * of matrix and mapped through precomputed colormap straight into scan lines of image.
+     * @param v Matrix to get heatmap from.
+     * @param grayscale True renders QImage::Format_Grayscale8 image with minimum black and maximum white,
+     * false renders QImage::Format_RGB32 image from dark blue to red.
+     * @return QImage with heatmap.
+     */
+    static QImage toImage(const vec2d & v, bool grayscale = false);
+
+    /**
+     * @brief Creates class folder inside dataset's root directory. If exists then nothing happens.
+     * @param root Dataset's root directory.
+     * @param className Name of class.
+     * @return True if folder exists after call.
+     */
+    static bool prepareClassFolder(const QString & root, const QString & className);
+
+    /**
+     * @brief Save spectogram in plain .txt, one row per line. Whole file is formatted into buffer
+     * reused by calling thread and written at once.
+     * @param fname Filename.
+     * @param dname Directory path.
+     * @param data Spectogram data.
+     * @param precision Significant digits of values, negative for text that reads back exactly, which is the shortest one
+     * where standard library has floating point std::to_chars.
+     * @param delimiter Separator of values in single row.
+     * @return True on success.
+     */
+    static bool savePlain(const QString & fname, const QString & dname, const vec2d & data,
+                          int precision = -1, char delimiter = ' ');
+
+    /**
+     * @brief Save spectogram as color image in .jpg format.
+     * @param fname Filename.
+     * @param dname Directory path.
+     * @param img Heatmap of spectogram.
+     * @return True on success.
+     */
+    static bool saveColorImg(const QString & fname, const QString & dname, const QImage & img);
+
+    /**
+     * @brief Save spectogram as grayscale image in .jpg format.
+     * @param fname Filename.
+     * @param dname Directory path.
+     * @param img Heatmap of spectogram, converted if it isn't grayscale already.
+     * @return True on success.
+     */
+    static bool saveGrayscaleImg(const QString & fname, const QString & dname, const QImage & img);
+
+    /**
+     * @brief Save spectogram as 2D numpy array .npy. Values are converted straight from matrix into buffer
+     * that is written at once together with header.
+     * @param fname Filename.
+     * @param dname Directory path.
+     * @param data Spectogram data.
+     * @param type Element type of saved array.
+     * @return True on success.
+     */
+    static bool saveNumpy(const QString & fname, const QString & dname, const vec2d & data, NumpyType type = NumpyType::Float32);
+
+    /**
+     * @brief Save spectogram in given format. Shards are written by ShardWriter so they always fail here.
+     * @param format File format.
+     * @param fname Filename.
+     * @param dname Directory path.
+     * @param data Spectogram data.
+     * @param img Heatmap of spectogram rendered by toImage() in matching color mode, computed from data if null
+     * and format is an image.
+     * @param options Format specific options.
+     * @return True on success.
+     */
+    static bool save(SpectogramFormat format, const QString & fname, const QString & dname,
+                     const vec2d & data, const QImage & img = QImage(), const SaveOptions & options = SaveOptions());
+};
+
+extern template class SpectogramWriter<float>;
+extern template class SpectogramWriter<double>;
+extern template class SpectogramWriter<long double>;
+
+#endif // SPECTOGRAMWRITER_H
@@ -0,0 +1,102 @@
+#include "threadpool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned int numThreads) : nextChunk(0) {
+    if(numThreads == 0)
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    // calling thread also processes chunks so it needs one worker less
+    for(unsigned int i = 1; i < numThreads; i++){
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool(){
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobReady.notify_all();
+
+    for(std::thread & worker : workers){
+        worker.join();
+    }
+}
+
+void ThreadPool::workerLoop(){
+    unsigned long seenGeneration = 0;
+
+    while(true){
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobReady.wait(lock, [&](){return stopping || generation != seenGeneration;});
+            if(stopping)
+                return;
+            seenGeneration = generation;
+        }
+
+        runChunks();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            busyWorkers--;
+        }
+        jobDone.notify_one();
+    }
+}
+
+void ThreadPool::runChunks(){
+    while(true){
+        const std::size_t begin = nextChunk.fetch_add(jobChunk);
+        if(begin >= jobCount)
+            return;
+
+        try{
+            (*job)(begin, std::min(begin + jobChunk, jobCount));
+        }
+        catch(...){
+            std::lock_guard<std::mutex> lock(mutex);
+            if(!error)
+                error = std::current_exception();
+        }
+    }
+}
+
+void ThreadPool::parallelFor(std::size_t count, std::size_t chunkSize, const rangeFunction & fn){
+    if(count == 0)
+        return;
+    chunkSize = std::max<std::size_t>(chunkSize, 1);
+
+    // not worth waking workers up
+    if(workers.empty() || count <= chunkSize){
+        fn(0, count);
+        return;
+    }
+
+    std::lock_guard<std::mutex> submitLock(submitMutex);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = &fn;
+        jobCount = count;
+        jobChunk = chunkSize;
+        nextChunk = 0;
+        error = nullptr;
+        busyWorkers = static_cast<unsigned int>(workers.size());
+        generation++;
+    }
+    jobReady.notify_all();
+
+    runChunks();
+
+    std::exception_ptr jobError;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        jobDone.wait(lock, [&](){return busyWorkers == 0;});
+        job = nullptr;
+        jobError = error;
+    }
+
+    if(jobError)
+        std::rethrow_exception(jobError);
+}
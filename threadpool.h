@@ -0,0 +1,76 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <exception>
+
+/**
+ * @brief Fixed set of worker threads that split loops into chunks and process them in parallel.
+ */
+class ThreadPool
+{
+public:
+    typedef std::function<void(std::size_t, std::size_t)> rangeFunction;
+
+private:
+    std::vector<std::thread> workers;
+
+    std::mutex submitMutex; //!< Allows only one parallelFor at a time.
+    std::mutex mutex; //!< Guards everything below.
+    std::condition_variable jobReady;
+    std::condition_variable jobDone;
+
+    const rangeFunction * job = nullptr; //!< Function of current loop.
+    std::size_t jobCount = 0; //!< Number of iterations of current loop.
+    std::size_t jobChunk = 0; //!< Number of iterations in single chunk.
+    std::atomic<std::size_t> nextChunk; //!< Index of first iteration of next chunk to take.
+    unsigned long generation = 0; //!< Incremented on every new loop so workers know there is work to do.
+    unsigned int busyWorkers = 0; //!< Number of workers still processing current loop.
+    std::exception_ptr error; //!< First exception thrown by current loop.
+    bool stopping = false;
+
+    /**
+     * @brief Main function of every worker thread.
+     */
+    void workerLoop();
+
+    /**
+     * @brief Take chunks of current loop until there is none left.
+     */
+    void runChunks();
+
+public:
+    /**
+     * @brief Class constructor.
+     * @param numThreads Number of threads processing every loop, including thread that calls parallelFor.
+     * 0 uses number of hardware threads.
+     */
+    explicit ThreadPool(unsigned int numThreads = 0);
+
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool & operator=(const ThreadPool &) = delete;
+
+    /**
+     * @brief Get number of threads processing every loop.
+     * @return Number of threads, including thread that calls parallelFor.
+     */
+    unsigned int size() const {return static_cast<unsigned int>(workers.size()) + 1;}
+
+    /**
+     * @brief Call fn(begin, end) for consecutive chunks of range [0, count) and wait until every chunk is processed.
+     * If any call throws then first exception is rethrown here after all threads are done.
+     * @param count Number of iterations.
+     * @param chunkSize Maximum number of iterations in single chunk.
+     * @param fn Function processing iterations from begin to end (exclusive).
+     */
+    void parallelFor(std::size_t count, std::size_t chunkSize, const rangeFunction & fn);
+};
+
+#endif // THREADPOOL_H